@@ -0,0 +1,135 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bench
+{
+  using bench_clock = std::chrono::steady_clock;
+
+  /**
+   * @brief A named parameter of a scenario, e.g. {"dependents", 1000}
+   */
+  using Param = std::pair<const char *, double>;
+
+  /**
+   * @brief Per operation timings of a scenario, over several samples
+   */
+  struct Measurement
+  {
+    std::string scenario;
+    std::vector<Param> params;
+    std::size_t ops_per_sample;
+    std::size_t samples;
+    double median_ns;
+    double min_ns;
+    double max_ns;
+  };
+
+  /**
+   * @brief Runs scenarios & reports their timings as JSON.
+   *
+   * A scenario body performs ops_per_sample operations and is timed as a whole, once as a warm up,
+   * then until `samples` samples are taken or the time budget of the scenario is spent.
+   * Scenarios whose name does not contain the filter are skipped.
+   */
+  class Suite
+  {
+  public:
+    explicit Suite(std::string filter = {}, std::size_t samples = 15,
+                   std::chrono::milliseconds budget = std::chrono::milliseconds{2000})
+        : mFilter{std::move(filter)}, mSamples{samples}, mBudget{budget}
+    {
+    }
+
+    /**
+     * @param setup Called before each sample, not timed
+     * @param body Called for each sample, performs ops_per_sample operations
+     */
+    template <typename Setup_t, typename Body_t>
+    void run(const char *scenario, std::vector<Param> params, std::size_t ops_per_sample,
+             const Setup_t &setup, const Body_t &body)
+    {
+      if (std::string{scenario}.find(mFilter) == std::string::npos)
+        return;
+
+      setup();
+      body();
+
+      std::vector<double> perOp;
+      auto deadline = bench_clock::now() + mBudget;
+      while (perOp.size() < mSamples && (perOp.size() < 3 || bench_clock::now() < deadline))
+      {
+        setup();
+        auto start = bench_clock::now();
+        body();
+        std::chrono::duration<double, std::nano> elapsed = bench_clock::now() - start;
+        perOp.push_back(elapsed.count() / ops_per_sample);
+      }
+
+      std::sort(perOp.begin(), perOp.end());
+      mResults.push_back({scenario, std::move(params), ops_per_sample, perOp.size(),
+                          perOp[perOp.size() / 2], perOp.front(), perOp.back()});
+      std::fprintf(stderr, "%-24s", scenario);
+      for (const Param &param : mResults.back().params)
+        std::fprintf(stderr, " %s=%.15g", param.first, param.second);
+      std::fprintf(stderr, "  %.1f ns/op\n", mResults.back().median_ns);
+    }
+
+    template <typename Body_t>
+    void run(const char *scenario, std::vector<Param> params, std::size_t ops_per_sample, const Body_t &body)
+    {
+      run(scenario, std::move(params), ops_per_sample, []() {}, body);
+    }
+
+    /**
+     * @brief Writes the results as a JSON document
+     */
+    void write_json(std::FILE *out) const
+    {
+      std::fprintf(out, "{\n  \"suite\": \"data-management\",\n  \"unit\": \"ns/op\",\n  \"results\": [");
+      for (std::size_t i = 0; i < mResults.size(); ++i)
+      {
+        const Measurement &result = mResults[i];
+        std::fprintf(out, "%s\n    {\"scenario\": \"%s\", \"params\": {", i ? "," : "", result.scenario.c_str());
+        for (std::size_t p = 0; p < result.params.size(); ++p)
+          std::fprintf(out, "%s\"%s\": %.15g", p ? ", " : "", result.params[p].first, result.params[p].second);
+        std::fprintf(out, "}, \"ops_per_sample\": %zu, \"samples\": %zu, "
+                          "\"median\": %.3f, \"min\": %.3f, \"max\": %.3f}",
+                     result.ops_per_sample, result.samples, result.median_ns, result.min_ns, result.max_ns);
+      }
+      std::fprintf(out, "\n  ]\n}\n");
+    }
+
+    const std::vector<Measurement> &results() const { return mResults; }
+
+  private:
+    std::string mFilter;
+    std::size_t mSamples;
+    std::chrono::milliseconds mBudget;
+    std::vector<Measurement> mResults;
+  };
+
+  /**
+   * @brief Keeps a value from being optimized away
+   */
+  template <typename T>
+  inline void keep(const T &value)
+  {
+    asm volatile("" : : "g"(&value) : "memory");
+  }
+} // namespace bench
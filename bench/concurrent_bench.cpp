@@ -0,0 +1,115 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#include "concurrent_data_manager.hpp"
+#include "data_manager.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  using bench_clock = std::chrono::steady_clock;
+
+  constexpr std::size_t max_threads = 64;
+  constexpr int sets_per_thread = 100000;
+
+  /**
+   * @brief One field per writer thread, each on its own cache line
+   */
+  struct alignas(64) Field
+  {
+    long value = 0;
+  };
+
+  struct Data
+  {
+    Field fields[max_threads];
+  };
+
+  /**
+   * @brief The single-threaded manager behind one global mutex
+   */
+  struct GlobalLockManager
+  {
+    dmgmt::DataManager<Data> manager;
+    std::mutex mutex;
+
+    const Data &get() { return manager.get(); }
+
+    template <typename El_t, typename Functor_t>
+    void register_callback(const El_t &element, const Functor_t &functor) { manager.register_callback(element, functor); }
+
+    void set_history_limits(std::size_t max_entries, std::size_t max_bytes) { manager.set_history_limits(max_entries, max_bytes); }
+
+    void set(const Field &field, const Field &value)
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      manager.set(field, value);
+    }
+  };
+
+  /**
+   * @brief Each thread sets its own field, a callback is registered on every field
+   * @return Sets per second, all threads included
+   */
+  template <typename Manager_t>
+  double measure(std::size_t threads)
+  {
+    auto manager = std::make_unique<Manager_t>();
+    std::atomic<long> sink{0};
+    for (const Field &field : manager->get().fields)
+      manager->register_callback(field, [&sink](const Field &f) { sink.fetch_add(f.value, std::memory_order_relaxed); });
+    manager->set_history_limits(4096, std::size_t(1) << 24);
+
+    std::vector<std::thread> workers;
+    auto start = bench_clock::now();
+    for (std::size_t t = 0; t < threads; ++t)
+      workers.emplace_back([&manager, t]() {
+        const Field &field = manager->get().fields[t];
+        for (int i = 1; i <= sets_per_thread; ++i)
+          manager->set(field, Field{i});
+      });
+    for (std::thread &worker : workers)
+      worker.join();
+    std::chrono::duration<double> elapsed = bench_clock::now() - start;
+
+    return threads * sets_per_thread / elapsed.count();
+  }
+} // namespace
+
+int main(int argc, char **argv)
+{
+  std::size_t threads = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : std::thread::hardware_concurrency();
+  threads = std::clamp<std::size_t>(threads, 1, max_threads);
+
+  printf("disjoint writers, %d sets per thread\n", sets_per_thread);
+  printf("  threads      global lock sets/s   sharded locks sets/s   speedup\n");
+  std::vector<std::size_t> counts;
+  for (std::size_t n = 1; n < threads; n *= 2)
+    counts.push_back(n);
+  counts.push_back(threads);
+
+  for (std::size_t n : counts)
+  {
+    double global = measure<GlobalLockManager>(n);
+    double sharded = measure<dmgmt::ConcurrentDataManager<Data>>(n);
+    printf("  %7zu  %21.0f  %21.0f  %7.2fx\n", n, global, sharded, sharded / global);
+  }
+
+  return 0;
+}
@@ -0,0 +1,118 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#include "flat_multimap.hpp"
+#include "poly_fun.hpp"
+#include "signature.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+  using bench_clock = std::chrono::steady_clock;
+
+  /**
+   * @brief The Signature hash the callback maps used before: address hash XOR type hash
+   */
+  struct XorHash
+  {
+    std::size_t operator()(const dmgmt::Signature &s) const
+    {
+      return std::hash<const void *>()(s.address()) ^ std::hash<const void *>()(s.type_id());
+    }
+  };
+
+  struct Result
+  {
+    double registrations_per_second;
+    double lookups_per_second;
+  };
+
+  /**
+   * @brief Registers a callback on each element (two on every fourth one), then looks up
+   * and calls the callbacks of the elements `rounds` times in `order`
+   */
+  template <typename Register_t, typename Lookup_t>
+  Result measure(const std::vector<int> &elements, const std::vector<unsigned> &order, int rounds,
+                 const Register_t &registration, const Lookup_t &lookup)
+  {
+    auto start = bench_clock::now();
+    for (unsigned i = 0; i < elements.size(); ++i)
+    {
+      registration(dmgmt::Signature{elements[i]});
+      if (i % 4 == 0)
+        registration(dmgmt::Signature{elements[i]});
+    }
+    std::chrono::duration<double> registered = bench_clock::now() - start;
+
+    start = bench_clock::now();
+    for (int round = 0; round < rounds; ++round)
+      for (unsigned i : order)
+        lookup(dmgmt::Signature{elements[i]});
+    std::chrono::duration<double> looked = bench_clock::now() - start;
+
+    return {elements.size() * 1.25 / registered.count(), double(order.size()) * rounds / looked.count()};
+  }
+
+  void report(std::size_t count, int rounds, long long &sink)
+  {
+    std::vector<int> elements(count, 1);
+    std::vector<unsigned> order(count);
+    for (unsigned i = 0; i < order.size(); ++i)
+      order[i] = i;
+    std::shuffle(order.begin(), order.end(), std::mt19937{42});
+    auto callback = dmgmt::PolyFun::fmt<int>([&sink](const int &val) { sink += val; });
+
+    std::unordered_multimap<dmgmt::Signature, dmgmt::PolyFun, XorHash> nodes;
+    Result old_res = measure(
+        elements, order, rounds,
+        [&](const dmgmt::Signature &sig) { nodes.insert({sig, callback}); },
+        [&](const dmgmt::Signature &sig) {
+          auto range = nodes.equal_range(sig);
+          for (auto it = range.first; it != range.second; ++it)
+            it->second.invoke(sig);
+        });
+
+    dmgmt::FlatMultimap<dmgmt::Signature, const dmgmt::PolyFun *> flat;
+    std::deque<dmgmt::PolyFun> pool;
+    Result new_res = measure(
+        elements, order, rounds,
+        [&](const dmgmt::Signature &sig) { flat.insert(sig, &pool.emplace_back(callback)); },
+        [&](const dmgmt::Signature &sig) {
+          auto range = flat.equal_range(sig);
+          for (auto it = range.first; it != range.second; ++it)
+            it->second->invoke(sig);
+        });
+
+    printf("%zu elements, %zu callbacks\n", count, count + (count + 3) / 4);
+    printf("  registrations/s  unordered_multimap %12.0f  flat %12.0f  speedup %5.2fx\n",
+           old_res.registrations_per_second, new_res.registrations_per_second,
+           new_res.registrations_per_second / old_res.registrations_per_second);
+    printf("  lookups/s        unordered_multimap %12.0f  flat %12.0f  speedup %5.2fx\n",
+           old_res.lookups_per_second, new_res.lookups_per_second,
+           new_res.lookups_per_second / old_res.lookups_per_second);
+  }
+} // namespace
+
+int main()
+{
+  long long sink = 0;
+
+  report(100000, 20, sink);
+  report(1000000, 5, sink);
+
+  return sink == 0;
+}
@@ -0,0 +1,96 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#include "poly_fun.hpp"
+#include "poly_fun_old.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace
+{
+  using bench_clock = std::chrono::steady_clock;
+
+  struct Result
+  {
+    double registrations_per_second;
+    double calls_per_second;
+  };
+
+  /**
+   * @brief Registers `count` small lambdas into a vector of callables, then calls them
+   * `rounds` times in `order`. Registrations are interleaved with unrelated allocations,
+   * as they would be in a real application.
+   */
+  template <typename Fun_t, typename Make_t>
+  Result measure(const Make_t &make, const std::vector<unsigned> &order, int rounds, long long &sink)
+  {
+    std::vector<Fun_t> callbacks;
+    std::vector<std::unique_ptr<char[]>> noise;
+    callbacks.reserve(order.size());
+    noise.reserve(order.size());
+
+    auto start = bench_clock::now();
+    for (unsigned i = 0; i < order.size(); ++i)
+    {
+      callbacks.push_back(make([&sink, i](const int &val) { sink += val + i; }));
+      noise.emplace_back(new char[64]);
+    }
+    std::chrono::duration<double> registration = bench_clock::now() - start;
+
+    int element = 1;
+    dmgmt::Signature sig{element};
+    start = bench_clock::now();
+    for (int round = 0; round < rounds; ++round)
+      for (unsigned i : order)
+        callbacks[i].invoke(sig);
+    std::chrono::duration<double> calls = bench_clock::now() - start;
+
+    return {order.size() / registration.count(), order.size() * rounds / calls.count()};
+  }
+
+  void report(const char *scenario, const std::vector<unsigned> &order, int rounds, long long &sink)
+  {
+    Result old_res = measure<::PolyFun>(
+        [](const auto &fun) { return ::PolyFun{::PolyFun::fmt<int>(fun)}; }, order, rounds, sink);
+    Result new_res = measure<dmgmt::PolyFun>(
+        [](const auto &fun) { return dmgmt::PolyFun::fmt<int>(fun); }, order, rounds, sink);
+
+    printf("%s (%zu callbacks)\n", scenario, order.size());
+    printf("  registrations/s  old %12.0f  new %12.0f  speedup %5.2fx\n",
+           old_res.registrations_per_second, new_res.registrations_per_second,
+           new_res.registrations_per_second / old_res.registrations_per_second);
+    printf("  calls/s          old %12.0f  new %12.0f  speedup %5.2fx\n",
+           old_res.calls_per_second, new_res.calls_per_second,
+           new_res.calls_per_second / old_res.calls_per_second);
+  }
+} // namespace
+
+int main()
+{
+  long long sink = 0;
+
+  std::vector<unsigned> hot(10000);
+  for (unsigned i = 0; i < hot.size(); ++i)
+    hot[i] = i;
+  report("hot, sequential calls", hot, 1000, sink);
+
+  std::vector<unsigned> cold(1000000);
+  for (unsigned i = 0; i < cold.size(); ++i)
+    cold[i] = i;
+  std::shuffle(cold.begin(), cold.end(), std::mt19937{42});
+  report("cold, random order calls", cold, 10, sink);
+
+  return sink == 0;
+}
@@ -0,0 +1,98 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#include "sharded_manager.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  using bench_clock = std::chrono::steady_clock;
+
+  constexpr std::size_t max_shards = 64;
+  constexpr std::size_t fields_per_shard = 64;
+  constexpr int sets_per_shard = 400000;
+  constexpr int sets_per_task = 1000;
+
+  /**
+   * @brief The elements of one shard, on their own cache lines
+   */
+  struct alignas(64) Partition
+  {
+    long fields[fields_per_shard] = {};
+    long sink = 0; // Written by the callbacks
+  };
+
+  /**
+   * @brief Each shard sets its own fields, a callback is registered on every field.
+   * The first field of each shard has a dependant in the next shard, 1 set in 64 crosses shards.
+   * @return Sets per second, all shards included
+   */
+  double measure(std::size_t shards)
+  {
+    auto partitions = std::make_unique<Partition[]>(shards);
+    dmgmt::ShardedManager manager{shards};
+    for (std::size_t s = 0; s < shards; ++s)
+    {
+      manager.place(partitions[s], s);
+      manager.post(s, [](dmgmt::StaticDataManager &shard) { shard.set_history_limits(4096, std::size_t(1) << 24); });
+      for (const long &field : partitions[s].fields)
+        manager.register_callback(field, [sink = &partitions[s].sink](const long &value) { *sink += value; });
+      if (shards > 1)
+        manager.register_dependency(partitions[s].fields[0], partitions[(s + 1) % shards].fields[1]);
+    }
+    manager.wait();
+
+    auto start = bench_clock::now();
+    for (int task = 0; task < sets_per_shard / sets_per_task; ++task)
+      for (std::size_t s = 0; s < shards; ++s)
+        manager.post(s, [partition = &partitions[s], task](dmgmt::StaticDataManager &shard) {
+          for (int i = 0; i < sets_per_task; ++i)
+          {
+            long value = long(task) * sets_per_task + i + 1;
+            shard.set(partition->fields[std::size_t(i) % fields_per_shard], value);
+          }
+        });
+    manager.wait();
+    std::chrono::duration<double> elapsed = bench_clock::now() - start;
+
+    return shards * double(sets_per_shard) / elapsed.count();
+  }
+} // namespace
+
+int main(int argc, char **argv)
+{
+  std::size_t shards = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : std::thread::hardware_concurrency();
+  shards = std::clamp<std::size_t>(shards, 1, max_shards);
+
+  printf("shard-local writes, %d sets per shard, 1 in %zu crossing to the next shard\n", sets_per_shard, fields_per_shard);
+  printf("  shards               sets/s   speedup\n");
+  std::vector<std::size_t> counts;
+  for (std::size_t n = 1; n < shards; n *= 2)
+    counts.push_back(n);
+  counts.push_back(shards);
+
+  double single = 0;
+  for (std::size_t n : counts)
+  {
+    double rate = measure(n);
+    if (n == 1)
+      single = rate;
+    printf("  %6zu  %19.0f  %7.2fx\n", n, rate, rate / single);
+  }
+
+  return 0;
+}
@@ -0,0 +1,357 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#include "bench.hpp"
+#include "static_data_manager.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+  constexpr std::size_t unlimited = std::numeric_limits<std::size_t>::max();
+
+  struct Counter
+  {
+    long long value = 0;
+    void add(int amount) { value += amount; }
+  };
+
+  template <std::size_t N>
+  struct Blob
+  {
+    std::array<unsigned char, N> bytes{};
+  };
+
+  /**
+   * @brief set() & call() of one element with one callback
+   */
+  void single_set(bench::Suite &suite)
+  {
+    constexpr std::size_t ops = 100000;
+    for (int callbacks : {0, 1})
+    {
+      dmgmt::StaticDataManager manager;
+      manager.set_history_limits(1024, unlimited);
+      int element = 0;
+      long long sum = 0;
+      if (callbacks)
+        manager.register_callback(element, [&sum](const int &val) { sum += val; });
+      suite.run("set", {{"callbacks", callbacks}}, ops, [&]() {
+        for (std::size_t i = 0; i < ops; ++i)
+          manager.set(element, int(i));
+      });
+
+      Counter counter;
+      if (callbacks)
+        manager.register_callback(counter, [&sum](const Counter &c) { sum += c.value; });
+      suite.run("call", {{"callbacks", callbacks}}, ops, [&]() {
+        for (std::size_t i = 0; i < ops; ++i)
+          manager.call(counter, &Counter::add, 1);
+      });
+      bench::keep(sum);
+    }
+  }
+
+  /**
+   * @brief set() of a 256 byte element with one callback, to a new value or to the value it already has
+   */
+  void unchanged_set(bench::Suite &suite)
+  {
+    constexpr std::size_t ops = 100000;
+    for (bool unchanged : {false, true})
+    {
+      dmgmt::StaticDataManager manager;
+      manager.set_history_limits(1024, unlimited);
+      Blob<256> element;
+      Blob<256> value;
+      long long calls = 0;
+      manager.register_callback(element, [&calls](const Blob<256> &) { ++calls; });
+      suite.run("unchanged_set", {{"unchanged", unchanged}}, ops, [&]() {
+        for (std::size_t i = 0; i < ops; ++i)
+        {
+          if (!unchanged)
+            value.bytes[i % 256] ^= 1;
+          manager.set(element, value);
+        }
+      });
+      bench::keep(calls);
+    }
+  }
+
+  /**
+   * @brief set() of a string element, from a copied or a moved value
+   */
+  void string_set(bench::Suite &suite)
+  {
+    constexpr std::size_t ops = 10000;
+    for (std::size_t length : {16, 4096})
+      for (int moved : {0, 1})
+      {
+        dmgmt::StaticDataManager manager;
+        manager.set_history_limits(1024, unlimited);
+        std::string element;
+        std::vector<std::string> values(ops, std::string(length, 'x'));
+        suite.run("set_string", {{"length", double(length)}, {"moved", moved}}, ops,
+                  [&]() {
+                    // Alternate values, so that no set is skipped as unchanged
+                    for (std::size_t i = 0; i < ops; ++i)
+                      values[i] = std::string(length, i % 2 ? 'y' : 'x');
+                  },
+                  [&]() {
+                    for (std::string &value : values)
+                      if (moved)
+                        manager.set(element, std::move(value));
+                      else
+                        manager.set(element, value);
+                  });
+      }
+  }
+
+  /**
+   * @brief set() of an element on which `dependents` elements depend, each with a callback
+   */
+  void fan_out(bench::Suite &suite)
+  {
+    for (std::size_t dependents : {1, 10, 100, 1000, 10000})
+    {
+      dmgmt::StaticDataManager manager;
+      manager.set_history_limits(1024, unlimited);
+      int source = 0;
+      std::vector<int> destinations(dependents);
+      long long calls = 0;
+      for (int &destination : destinations)
+      {
+        manager.register_dependency(source, destination);
+        manager.register_callback(destination, [&calls](const int &) { ++calls; });
+      }
+      std::size_t ops = std::max<std::size_t>(10, 100000 / dependents);
+      suite.run("fan_out", {{"dependents", double(dependents)}}, ops, [&]() {
+        for (std::size_t i = 0; i < ops; ++i)
+          manager.set(source, int(i));
+      });
+      bench::keep(calls);
+    }
+  }
+
+  /**
+   * @brief set() of the first element of a dependency chain, each element with a callback
+   */
+  void deep_chain(bench::Suite &suite)
+  {
+    for (std::size_t depth : {10, 100, 1000, 10000})
+    {
+      dmgmt::StaticDataManager manager;
+      manager.set_history_limits(1024, unlimited);
+      std::vector<int> chain(depth);
+      long long calls = 0;
+      for (std::size_t i = 0; i < depth; ++i)
+      {
+        if (i + 1 < depth)
+          manager.register_dependency(chain[i], chain[i + 1]);
+        manager.register_callback(chain[i], [&calls](const int &) { ++calls; });
+      }
+      std::size_t ops = std::max<std::size_t>(10, 100000 / depth);
+      suite.run("deep_chain", {{"depth", double(depth)}}, ops, [&]() {
+        for (std::size_t i = 0; i < ops; ++i)
+          manager.set(chain[0], int(i));
+      });
+      bench::keep(calls);
+    }
+  }
+
+  /**
+   * @brief set() of the input of a chain of 100 computed values, the last one being read after every `period` sets
+   */
+  void computed_chain(bench::Suite &suite)
+  {
+    constexpr std::size_t ops = 10000;
+    constexpr std::size_t depth = 100;
+    for (std::size_t period : {1, 100})
+    {
+      dmgmt::StaticDataManager manager;
+      manager.set_history_limits(1024, unlimited);
+      int source = 0;
+      std::vector<dmgmt::Computed<long long>> chain{manager.register_computed([](int v) { return (long long)v; }, source)};
+      for (std::size_t i = 1; i < depth; ++i)
+        chain.push_back(manager.register_computed([](long long v) { return v + 1; }, chain.back()));
+      long long sum = 0;
+      suite.run("computed_chain", {{"read_period", double(period)}}, ops, [&]() {
+        for (std::size_t i = 0; i < ops; ++i)
+        {
+          manager.set(source, int(i));
+          if ((i + 1) % period == 0)
+            sum += *chain.back();
+        }
+      });
+      bench::keep(sum);
+    }
+  }
+
+  /**
+   * @brief set() of a large element changing one byte, recorded fully or as a delta
+   */
+  template <std::size_t N>
+  void large_snapshot(bench::Suite &suite)
+  {
+    for (auto encoding : {dmgmt::SnapshotEncoding::Full, dmgmt::SnapshotEncoding::Delta})
+    {
+      dmgmt::StaticDataManager manager;
+      manager.set_history_limits(64, unlimited);
+      manager.set_snapshot_encoding(encoding);
+      auto element = std::make_unique<Blob<N>>();
+      auto value = std::make_unique<Blob<N>>();
+      std::size_t ops = std::max<std::size_t>(10, (std::size_t{64} << 20) / N / 16);
+      suite.run("large_snapshot", {{"bytes", double(N)}, {"delta", encoding == dmgmt::SnapshotEncoding::Delta}}, ops,
+                [&]() {
+                  for (std::size_t i = 0; i < ops; ++i)
+                  {
+                    value->bytes[i % N] ^= 1;
+                    manager.set(*element, *value);
+                  }
+                });
+    }
+  }
+
+  /**
+   * @brief set() of a 4 KiB element changing one byte, then undo of the whole history,
+   * with the entries more than 16 undo steps old compressed or not
+   */
+  void compressed_history(bench::Suite &suite)
+  {
+    constexpr std::size_t N = 4096;
+    for (bool compressed : {false, true})
+    {
+      dmgmt::StaticDataManager manager;
+      manager.set_history_limits(256, unlimited);
+      if (compressed)
+        manager.set_history_compression(16);
+      auto element = std::make_unique<Blob<N>>();
+      auto value = std::make_unique<Blob<N>>();
+      std::size_t ops = 255;
+      suite.run("compressed_history", {{"compressed", compressed}}, 2 * ops, [&]() {
+        for (std::size_t i = 0; i < ops; ++i)
+        {
+          value->bytes[i * 61 % N] ^= 1;
+          manager.set(*element, *value);
+        }
+        while (manager.undo())
+          ;
+      });
+    }
+  }
+
+  /**
+   * @brief Undoes then redoes a whole history of single element changes
+   */
+  void undo_redo(bench::Suite &suite)
+  {
+    for (std::size_t length : {1000, 100000})
+    {
+      dmgmt::StaticDataManager manager;
+      std::vector<int> elements(64);
+      long long calls = 0;
+      for (int &element : elements)
+        manager.register_callback(element, [&calls](const int &) { ++calls; });
+      for (std::size_t i = 0; i < length; ++i)
+        manager.set(elements[i % elements.size()], int(i));
+      suite.run("undo_redo", {{"history", double(length)}}, 2 * length, [&]() {
+        while (manager.undo())
+          ;
+        while (manager.redo())
+          ;
+      });
+      bench::keep(calls);
+    }
+  }
+
+  /**
+   * @brief Registers a callback on each of `count` elements, then removes them
+   */
+  void registration_churn(bench::Suite &suite)
+  {
+    for (std::size_t count : {1000, 100000})
+    {
+      dmgmt::StaticDataManager manager;
+      std::vector<int> elements(count);
+      std::vector<dmgmt::StaticDataManager::callback_iter_t> handles(count);
+      long long calls = 0;
+      suite.run("registration_churn", {{"callbacks", double(count)}}, 2 * count, [&]() {
+        for (std::size_t i = 0; i < count; ++i)
+          handles[i] = manager.register_callback(elements[i], [&calls](const int &) { ++calls; });
+        for (std::size_t i = 0; i < count; ++i)
+          manager.remove_callback(handles[i]);
+      });
+      bench::keep(calls);
+    }
+  }
+
+  /**
+   * @brief Registers callbacks on `count` elements in turn, 64 per element, then removes them element by element
+   */
+  void interleaved_registration(bench::Suite &suite)
+  {
+    constexpr std::size_t per_element = 64;
+    for (std::size_t count : {100, 1000})
+    {
+      dmgmt::StaticDataManager manager;
+      std::vector<int> elements(count);
+      long long calls = 0;
+      suite.run("interleaved_registration", {{"elements", double(count)}}, count * per_element, [&]() {
+        for (std::size_t round = 0; round < per_element; ++round)
+          for (const int &element : elements)
+            manager.register_callback(element, [&calls](const int &) { ++calls; });
+        for (const int &element : elements)
+          manager.remove_callback(element);
+      });
+      bench::keep(calls);
+    }
+  }
+} // namespace
+
+/**
+ * Usage: suite.out [scenario filter] [json output path]
+ * The JSON results are written to stdout unless a path is given.
+ */
+int main(int argc, char **argv)
+{
+  bench::Suite suite{argc > 1 ? argv[1] : ""};
+
+  single_set(suite);
+  string_set(suite);
+  unchanged_set(suite);
+  fan_out(suite);
+  deep_chain(suite);
+  computed_chain(suite);
+  large_snapshot<64>(suite);
+  large_snapshot<4096>(suite);
+  large_snapshot<65536>(suite);
+  large_snapshot<1 << 20>(suite);
+  compressed_history(suite);
+  undo_redo(suite);
+  registration_churn(suite);
+  interleaved_registration(suite);
+
+  std::FILE *out = argc > 2 ? std::fopen(argv[2], "w") : stdout;
+  if (!out)
+  {
+    std::perror(argv[2]);
+    return 1;
+  }
+  suite.write_json(out);
+  if (out != stdout)
+    std::fclose(out);
+  return 0;
+}
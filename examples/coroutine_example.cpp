@@ -0,0 +1,115 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#include "data_manager.hpp"
+#include <coroutine>
+#include <cstdio>
+#include <deque>
+#include <exception>
+
+struct Sensor
+{
+  int temperature = 0;
+  int humidity = 0;
+};
+
+struct Station
+{
+  Sensor indoor;
+  Sensor outdoor;
+  bool heating = false;
+};
+
+using namespace dmgmt;
+
+/**
+ * @brief Minimal fire & forget coroutine: runs until its first co_await, its frame is freed when it returns
+ */
+struct Task
+{
+  struct promise_type
+  {
+    Task get_return_object() { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+/**
+ * @brief Event loop the coroutines awaiting a change are queued to, rather than resumed during propagation
+ */
+struct EventLoop
+{
+  void run()
+  {
+    while (!ready.empty())
+    {
+      std::coroutine_handle<> handle = ready.front();
+      ready.pop_front();
+      handle.resume();
+    }
+  }
+
+  std::deque<std::coroutine_handle<>> ready;
+};
+
+Task thermostat(DataManager<Station> &mgr, int threshold, int changes)
+{
+  const Station &station = mgr.get();
+  for (int i = 0; i < changes; ++i)
+  {
+    const Sensor &indoor = co_await changed(mgr, station.indoor);
+    bool heating = indoor.temperature < threshold;
+    printf("thermostat: indoor %d, heating %s\n", indoor.temperature, heating ? "on" : "off");
+    mgr.set(station.heating, heating);
+  }
+  printf("thermostat: done\n");
+}
+
+Task logger(DataManager<Station> &mgr, int changes)
+{
+  for (int i = 0; i < changes; ++i)
+  {
+    const Station &station = co_await changed(mgr, mgr.get());
+    printf("logger: indoor %d, outdoor %d, heating %s\n", station.indoor.temperature, station.outdoor.temperature,
+           station.heating ? "on" : "off");
+  }
+  printf("logger: done\n");
+}
+
+int main()
+{
+  DataManager<Station> mgr;
+  EventLoop loop;
+  set_change_scheduler(mgr, [&loop](std::coroutine_handle<> handle) { loop.ready.push_back(handle); });
+
+  // A change of a sensor member also wakes the coroutines awaiting the sensor & the station
+  mgr.set_containment_dependencies(true);
+
+  thermostat(mgr, 19, 2);
+  logger(mgr, 4);
+
+  mgr.set(mgr.get().indoor.temperature, 17);
+  loop.run();
+
+  mgr.set(mgr.get().outdoor.temperature, 5);
+  loop.run();
+
+  mgr.set(mgr.get().indoor.temperature, 21);
+  loop.run();
+
+  // Undo wakes the coroutines too, here by reverting the heating set by the thermostat
+  mgr.undo();
+  loop.run();
+
+  return 0;
+}
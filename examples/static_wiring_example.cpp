@@ -0,0 +1,60 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#include "data_manager.hpp"
+#include <cstdio>
+
+struct Point
+{
+  int x = 0;
+  int y = 0;
+};
+
+struct Shape
+{
+  Point origin;
+  int width = 0;
+};
+
+void on_x(int x) { printf("x: %d\n", x); }
+void on_origin(const Point &p) { printf("origin: (%d, %d)\n", p.x, p.y); }
+void on_shape(const Shape &s) { printf("shape: (%d, %d) width %d\n", s.origin.x, s.origin.y, s.width); }
+
+using namespace dmgmt;
+
+using X = Path<&Shape::origin, &Point::x>;
+using Y = Path<&Shape::origin, &Point::y>;
+using Origin = Path<&Shape::origin>;
+using Width = Path<&Shape::width>;
+using Root = Path<>;
+
+using ShapeManager = DataManager<Shape,
+                                 Callback<X, &on_x>,
+                                 Callback<Origin, &on_origin>,
+                                 Callback<Root, &on_shape>,
+                                 Depends<X, Origin>,
+                                 Depends<Y, Origin>,
+                                 Depends<Origin, Root>,
+                                 Depends<Width, Root>>;
+
+int main()
+{
+  ShapeManager smgr;
+
+  // Statically wired: direct calls in an order computed at compile time
+  smgr.set<X>(3);
+  smgr.set<Width>(10);
+
+  // Run-time set & undo call the statically wired callbacks too
+  smgr.set(smgr.get().origin.y, 4);
+  smgr.undo();
+
+  return 0;
+}
@@ -0,0 +1,256 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "mpsc_queue.hpp"
+
+namespace dmgmt
+{
+  /**
+   * @brief Where a callback is called
+   */
+  enum class CallbackDispatch
+  {
+    Sync, // By the thread that changed the element, before set/call returns
+    Async // By a worker thread of the manager's AsyncDispatcher, with a copy of the element
+  };
+
+  /**
+   * @brief Counters of an AsyncDispatcher.
+   * The latency is the time between a callback being queued and a worker starting to call it.
+   */
+  struct DispatchStats
+  {
+    std::size_t queue_depth;   // Callbacks queued and not started yet
+    std::uint64_t dispatched;  // Callbacks started since the creation of the dispatcher
+    std::chrono::nanoseconds mean_latency;
+    std::chrono::nanoseconds max_latency;
+    std::uint64_t failed; // Callbacks that threw, their exception is dropped
+  };
+
+  /**
+   * @brief A pool of worker threads calling asynchronous callbacks.
+   * Each worker consumes its own lock-free MpscQueue. A callback is bound to one worker when it is wrapped,
+   * so that its calls keep their order.
+   * Idle workers sleep until a callback is queued. Destroying the dispatcher waits for the queued callbacks.
+   * An exception thrown by a callback is dropped by its worker, which goes on with the next callbacks.
+   */
+  class AsyncDispatcher
+  {
+  public:
+    using dispatch_clock = std::chrono::steady_clock;
+
+    explicit AsyncDispatcher(std::size_t workers = std::max(1u, std::thread::hardware_concurrency()))
+    {
+      mWorkers.reserve(workers);
+      for (std::size_t i = 0; i < std::max<std::size_t>(workers, 1); ++i)
+        mWorkers.push_back(std::make_unique<Worker>());
+      for (auto &worker : mWorkers)
+        worker->thread = std::thread{[this, w = worker.get()]() { run(*w); }};
+    }
+
+    AsyncDispatcher(const AsyncDispatcher &) = delete;
+    AsyncDispatcher &operator=(const AsyncDispatcher &) = delete;
+
+    ~AsyncDispatcher()
+    {
+      for (auto &worker : mWorkers)
+      {
+        {
+          std::lock_guard<std::mutex> lock{worker->mutex};
+          worker->stop = true;
+        }
+        worker->wake.notify_one();
+      }
+      for (auto &worker : mWorkers)
+        worker->thread.join();
+    }
+
+    std::size_t workers() const { return mWorkers.size(); }
+
+    /**
+     * @brief Wraps a callback so that calling the wrapper queues a call with a copy of the element
+     * @tparam El_t Type of the element the callback is called with, must be copy constructible
+     * @param functor a functor with void(const El_t&) signature
+     * @return a functor with void(const El_t&) signature
+     */
+    template <typename El_t, typename Functor_t>
+    auto wrap(const Functor_t &functor)
+    {
+      return wrap<El_t>(functor, [](const El_t &element) { return element; });
+    }
+
+    /**
+     * @brief Wraps a callback so that calling the wrapper queues a call with a copy of the element made by a loader,
+     * e.g. one locking the element against concurrent writers
+     * @tparam El_t Type of the element the callback is called with, must be copy constructible
+     * @param functor a functor with void(const El_t&) signature
+     * @param loader a functor with El_t(const El_t&) signature, called by the thread calling the wrapper
+     * @return a functor with void(const El_t&) signature
+     */
+    template <typename El_t, typename Functor_t, typename Loader_t>
+    auto wrap(const Functor_t &functor, Loader_t loader)
+    {
+      static_assert(std::is_copy_constructible_v<El_t>, "asynchronous callbacks need copyable elements");
+      auto shared = std::make_shared<std::decay_t<Functor_t>>(functor);
+      Worker *worker = mWorkers[mNextWorker++ % mWorkers.size()].get();
+      return [this, worker, shared, loader = std::move(loader)](const El_t &element) {
+        post(*worker, [shared, copy = El_t(loader(element))]() { (*shared)(copy); });
+      };
+    }
+
+    /**
+     * @brief Blocks until every queued callback has returned
+     */
+    void wait() const
+    {
+      std::unique_lock<std::mutex> lock{mIdleMutex};
+      mIdle.wait(lock, [this]() { return mPending.load(std::memory_order_acquire) == 0; });
+    }
+
+    DispatchStats stats() const
+    {
+      DispatchStats stats{0, 0, std::chrono::nanoseconds{0}, std::chrono::nanoseconds{0}, 0};
+      std::uint64_t total = 0;
+      for (const auto &worker : mWorkers)
+      {
+        stats.queue_depth += worker->depth.load(std::memory_order_relaxed);
+        stats.dispatched += worker->dispatched.load(std::memory_order_relaxed);
+        stats.failed += worker->failed.load(std::memory_order_relaxed);
+        total += worker->total_latency.load(std::memory_order_relaxed);
+        stats.max_latency = std::max(stats.max_latency,
+                                     std::chrono::nanoseconds{worker->max_latency.load(std::memory_order_relaxed)});
+      }
+      if (stats.dispatched)
+        stats.mean_latency = std::chrono::nanoseconds{total / stats.dispatched};
+      return stats;
+    }
+
+  private:
+    /**
+     * @brief A queued call
+     */
+    struct Task : MpscNode
+    {
+      void (*pRun)(Task *task); // Calls then destroys the task
+      dispatch_clock::time_point posted;
+    };
+
+    template <typename F>
+    struct TaskModel : Task
+    {
+      explicit TaskModel(F &&fun) : mFun{std::move(fun)} { this->pRun = &run; }
+
+      static void run(Task *task)
+      {
+        std::unique_ptr<TaskModel> self{static_cast<TaskModel *>(task)};
+        self->mFun();
+      }
+
+      F mFun;
+    };
+
+    struct Worker
+    {
+      MpscQueue queue;
+      std::atomic<std::size_t> depth{0};
+      std::atomic<bool> sleeping{false};
+      std::atomic<std::uint64_t> dispatched{0};
+      std::atomic<std::uint64_t> failed{0};
+      std::atomic<std::uint64_t> total_latency{0}; // In nanoseconds
+      std::atomic<std::uint64_t> max_latency{0};   // In nanoseconds
+      std::mutex mutex;
+      std::condition_variable wake;
+      bool stop = false;
+      std::thread thread;
+    };
+
+    template <typename F>
+    void post(Worker &worker, F &&fun)
+    {
+      Task *task = new TaskModel<std::decay_t<F>>(std::forward<F>(fun));
+      task->posted = dispatch_clock::now();
+      mPending.fetch_add(1, std::memory_order_relaxed);
+      worker.depth.fetch_add(1, std::memory_order_seq_cst);
+      worker.queue.push(task);
+      if (worker.sleeping.load(std::memory_order_seq_cst))
+      {
+        std::lock_guard<std::mutex> lock{worker.mutex};
+        worker.wake.notify_one();
+      }
+    }
+
+    void run(Worker &worker)
+    {
+      for (;;)
+      {
+        if (worker.depth.load(std::memory_order_seq_cst) == 0)
+        {
+          std::unique_lock<std::mutex> lock{worker.mutex};
+          worker.sleeping.store(true, std::memory_order_seq_cst);
+          worker.wake.wait(lock, [&]() { return worker.stop || worker.depth.load(std::memory_order_seq_cst); });
+          worker.sleeping.store(false, std::memory_order_relaxed);
+          if (worker.stop && worker.depth.load(std::memory_order_seq_cst) == 0)
+            return;
+        }
+
+        auto task = static_cast<Task *>(worker.queue.pop());
+        if (!task) // A producer is between counting & pushing its task
+        {
+          std::this_thread::yield();
+          continue;
+        }
+        worker.depth.fetch_sub(1, std::memory_order_relaxed);
+
+        std::uint64_t latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                    dispatch_clock::now() - task->posted)
+                                    .count();
+        worker.dispatched.fetch_add(1, std::memory_order_relaxed);
+        worker.total_latency.fetch_add(latency, std::memory_order_relaxed);
+        if (latency > worker.max_latency.load(std::memory_order_relaxed))
+          worker.max_latency.store(latency, std::memory_order_relaxed);
+
+        try
+        {
+          task->pRun(task);
+        }
+        catch (...)
+        {
+          worker.failed.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (mPending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+          std::lock_guard<std::mutex> lock{mIdleMutex};
+          mIdle.notify_all();
+        }
+      }
+    }
+
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+    std::size_t mNextWorker = 0;
+    std::atomic<std::size_t> mPending{0}; // Callbacks queued or running
+    mutable std::mutex mIdleMutex;
+    mutable std::condition_variable mIdle; // Notified when mPending drops to 0
+  };
+} // namespace dmgmt
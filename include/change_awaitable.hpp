@@ -0,0 +1,271 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#pragma once
+
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <cstddef>
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+
+#include "dependency_graph.hpp"
+#include "signature.hpp"
+
+namespace dmgmt
+{
+  /**
+   * @brief A suspended coroutine, linked in the waiter list of the element it awaits.
+   * The link lives in the coroutine frame, so waiting does not allocate.
+   * The coroutine is held by address, so that the waiter lists are the same whatever the language standard.
+   */
+  class ChangeWaiter
+  {
+  public:
+    ChangeWaiter() = default;
+    ChangeWaiter(const ChangeWaiter &) = delete;
+    ChangeWaiter &operator=(const ChangeWaiter &) = delete;
+
+    ~ChangeWaiter() { unlink(); }
+
+  protected:
+    friend class ChangeWaiters;
+
+    bool linked() const { return pNext != this; }
+
+    void link_before(ChangeWaiter &next)
+    {
+      pPrev = next.pPrev;
+      pNext = &next;
+      pPrev->pNext = this;
+      next.pPrev = this;
+    }
+
+    void unlink()
+    {
+      pPrev->pNext = pNext;
+      pNext->pPrev = pPrev;
+      pPrev = pNext = this;
+    }
+
+    ChangeWaiter *pPrev = this;
+    ChangeWaiter *pNext = this;
+    void *pCoroutine = nullptr;                 // Address of the coroutine
+    void (*pResume)(void *coroutine) = nullptr; // Resumes the coroutine in place
+  };
+
+  /**
+   * @brief The waiter lists of the awaited elements.
+   * An awaited element has one hook in the dependency graph while coroutines wait for it:
+   * it resumes them, through the scheduler if one is set, when the element or anything it depends on changes.
+   * The list & its hook are dropped once the list is empty.
+   */
+  class ChangeWaiters
+  {
+  public:
+    /**
+     * @brief The waiters of an element, linked before the list head
+     */
+    struct List : ChangeWaiter
+    {
+      Signature element;
+      DependencyGraph::hook_iter_t hook;
+      std::size_t waking = 0; // Wakes in progress, the list is not dropped meanwhile
+    };
+
+    explicit ChangeWaiters(DependencyGraph &graph)
+        : pGraph{&graph}
+    {
+    }
+
+    ChangeWaiters(const ChangeWaiters &) = delete;
+    ChangeWaiters &operator=(const ChangeWaiters &) = delete;
+
+    /**
+     * @brief Unlinks the waiters left, their coroutines are not resumed
+     */
+    ~ChangeWaiters()
+    {
+      for (auto &[element, list] : mLists)
+      {
+        while (list.linked())
+          list.pNext->unlink();
+        pGraph->remove_hook(list.hook);
+      }
+    }
+
+    /**
+     * @param scheduler Called with the address of each coroutine to resume, which is resumed in place if empty
+     */
+    void set_scheduler(std::function<void(void *coroutine)> scheduler) { mScheduler = std::move(scheduler); }
+
+    /**
+     * @brief Returns the waiter list of an element, created with its hook if no coroutine waits for the element
+     */
+    template <typename El_t>
+    List &list(const El_t &element)
+    {
+      auto [it, inserted] = mLists.try_emplace(Signature{element});
+      List &list = it->second;
+      if (inserted)
+      {
+        list.element = it->first;
+        list.hook = pGraph->register_hook(element, [this, list = &list](const El_t &) { wake(*list); });
+      }
+      return list;
+    }
+
+    /**
+     * @brief Drops a list left empty by a waiter destroyed while suspended
+     */
+    void abandon(List &list)
+    {
+      if (!list.linked() && !list.waking)
+        drop(list);
+    }
+
+    /**
+     * @brief Returns the number of elements coroutines wait for
+     */
+    std::size_t elements() const { return mLists.size(); }
+
+    /**
+     * @brief Returns the number of suspended coroutines
+     */
+    std::size_t size() const
+    {
+      std::size_t count = 0;
+      for (const auto &[element, list] : mLists)
+        for (const ChangeWaiter *waiter = list.pNext; waiter != &list; waiter = waiter->pNext)
+          ++count;
+      return count;
+    }
+
+  private:
+    void wake(List &list)
+    {
+      // Take the whole list first: a resumed coroutine awaiting the element again waits for its next change
+      ChangeWaiter woken;
+      if (list.linked())
+      {
+        woken.link_before(*list.pNext);
+        list.unlink();
+      }
+      ++list.waking;
+      while (woken.linked())
+      {
+        ChangeWaiter &waiter = *woken.pNext;
+        waiter.unlink();
+        if (mScheduler)
+          mScheduler(waiter.pCoroutine);
+        else
+          waiter.pResume(waiter.pCoroutine);
+      }
+      --list.waking;
+      abandon(list); // The hook is retired by the graph, not destroyed while it runs
+    }
+
+    void drop(List &list)
+    {
+      pGraph->remove_hook(list.hook);
+      mLists.erase(list.element);
+    }
+
+    DependencyGraph *pGraph;
+    std::unordered_map<Signature, List> mLists;
+    std::function<void(void *coroutine)> mScheduler;
+  };
+
+#if defined(__cpp_impl_coroutine)
+  /**
+   * @brief Function resuming the coroutines whose awaited element changed, called during propagation
+   */
+  using ChangeScheduler = std::function<void(std::coroutine_handle<>)>;
+
+  /**
+   * @brief Awaitable suspending a coroutine until an element changes, see changed(manager, element)
+   * @return The element, read when the coroutine is resumed
+   */
+  template <typename El_t>
+  class ChangeAwaitable : private ChangeWaiter
+  {
+  public:
+    ChangeAwaitable(ChangeWaiters &waiters, const El_t &element)
+        : pWaiters{&waiters},
+          pElement{&element}
+    {
+    }
+
+    /**
+     * @brief Unlinks the waiter of a coroutine destroyed while suspended
+     */
+    ~ChangeAwaitable()
+    {
+      if (linked())
+      {
+        unlink();
+        pWaiters->abandon(*pList);
+      }
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+      pCoroutine = handle.address();
+      pResume = [](void *coroutine) { std::coroutine_handle<>::from_address(coroutine).resume(); };
+      pList = &pWaiters->list(*pElement);
+      link_before(*pList);
+    }
+
+    const El_t &await_resume() const noexcept { return *pElement; }
+
+  private:
+    ChangeWaiters *pWaiters;
+    ChangeWaiters::List *pList = nullptr;
+    const El_t *pElement;
+  };
+
+  /**
+   * @brief Returns an awaitable suspending the awaiting coroutine until the element or anything it depends on changes,
+   * e.g. `const auto &value = co_await changed(manager, element);`.
+   * The coroutine is resumed during propagation, by the change scheduler if one is set.
+   * The waits on an element are woken by a hook of the dependency graph, which remove_callback(element) leaves in place.
+   * These are free functions so that the managers are the same class whatever the language standard.
+   * @param manager StaticDataManager or DataManager the element is managed by
+   * @param element Element to wait for a change of
+   */
+  template <typename Manager_t, typename El_t>
+  ChangeAwaitable<El_t> changed(Manager_t &manager, const El_t &element)
+  {
+    return {manager.change_waiters(), element};
+  }
+
+  /**
+   * @brief Sets the function the coroutines awaiting a change of a manager's elements are resumed by,
+   * e.g. queueing them to an event loop
+   * @param manager StaticDataManager or DataManager
+   * @param scheduler Called with each coroutine to resume, coroutines are resumed in place if empty
+   */
+  template <typename Manager_t>
+  void set_change_scheduler(Manager_t &manager, ChangeScheduler scheduler)
+  {
+    ChangeWaiters &waiters = manager.change_waiters();
+    if (!scheduler)
+      return waiters.set_scheduler({});
+    waiters.set_scheduler([scheduler = std::move(scheduler)](void *coroutine) {
+      scheduler(std::coroutine_handle<>::from_address(coroutine));
+    });
+  }
+#endif
+} // namespace dmgmt
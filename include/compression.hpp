@@ -0,0 +1,152 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <memory_resource>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace dmgmt
+{
+  /**
+   * @brief Compresses bytes with a byte oriented LZ77 codec in the spirit of LZ4:
+   * a sequence is a token (literal count & match length on 4 bits each, 15 meaning that bytes of 255 and a last one follow),
+   * the literals, then the match as a 2 byte little-endian offset. The last sequence only has literals.
+   * Matches may overlap their output, which makes runs of a repeated byte a few bytes long.
+   * @param out Buffer the compressed bytes are appended to
+   */
+  inline void lz_compress(const std::byte *data, std::size_t size, std::pmr::vector<std::byte> &out)
+  {
+    constexpr std::size_t min_match = 4;
+    constexpr std::size_t max_offset = 65535;
+    constexpr unsigned hash_bits = 12;
+
+    auto read32 = [data](std::size_t at) {
+      std::uint32_t word;
+      std::memcpy(&word, data + at, sizeof(word));
+      return word;
+    };
+    auto length = [&out](std::size_t value) {
+      for (; value >= 255; value -= 255)
+        out.push_back(std::byte{255});
+      out.push_back(std::byte(value));
+    };
+    auto literals = [&](std::size_t anchor, std::size_t end, std::size_t match) {
+      std::size_t count = end - anchor;
+      std::size_t extra = match - min_match;
+      out.push_back(std::byte((std::min<std::size_t>(count, 15) << 4) | std::min<std::size_t>(extra, 15)));
+      if (count >= 15)
+        length(count - 15);
+      out.insert(out.end(), data + anchor, data + end);
+    };
+
+    std::array<std::uint32_t, std::size_t{1} << hash_bits> table;
+    table.fill(UINT32_MAX);
+    std::size_t anchor = 0;
+    std::size_t i = 0;
+    while (i + min_match <= size)
+    {
+      std::uint32_t word = read32(i);
+      std::uint32_t &slot = table[(word * 2654435761u) >> (32 - hash_bits)];
+      std::size_t candidate = slot;
+      slot = std::uint32_t(i);
+      if (candidate == UINT32_MAX || i - candidate > max_offset || read32(candidate) != word)
+      {
+        ++i;
+        continue;
+      }
+      std::size_t match = min_match;
+      for (std::uint64_t l, r; i + match + sizeof(l) <= size; match += sizeof(l))
+      {
+        std::memcpy(&l, data + candidate + match, sizeof(l));
+        std::memcpy(&r, data + i + match, sizeof(r));
+        if (l != r)
+          break;
+      }
+      while (i + match < size && data[candidate + match] == data[i + match])
+        ++match;
+      literals(anchor, i, match);
+      std::size_t offset = i - candidate;
+      out.push_back(std::byte(offset & 0xFF));
+      out.push_back(std::byte(offset >> 8));
+      if (match - min_match >= 15)
+        length(match - min_match - 15);
+      i += match;
+      anchor = i;
+    }
+    literals(anchor, size, min_match);
+  }
+
+  /**
+   * @brief Decompresses bytes written by lz_compress
+   * @return false if the compressed bytes are malformed or do not decompress to exactly size bytes
+   */
+  inline bool lz_decompress(const std::byte *data, std::size_t size, std::byte *out, std::size_t out_size)
+  {
+    constexpr std::size_t min_match = 4;
+    const std::byte *in = data;
+    const std::byte *in_end = data + size;
+    std::byte *op = out;
+    std::byte *op_end = out + out_size;
+
+    auto length = [&](std::size_t &value) {
+      for (std::byte extra{255}; extra == std::byte{255};)
+      {
+        if (in == in_end)
+          return false;
+        extra = *in++;
+        value += std::size_t(extra);
+      }
+      return true;
+    };
+
+    while (in < in_end)
+    {
+      unsigned token = unsigned(*in++);
+      std::size_t count = token >> 4;
+      if (count == 15 && !length(count))
+        return false;
+      if (std::size_t(in_end - in) < count || std::size_t(op_end - op) < count)
+        return false;
+      if (count)
+        std::memcpy(op, in, count);
+      in += count;
+      op += count;
+      if (in == in_end)
+        break;
+
+      if (in_end - in < 2)
+        return false;
+      std::size_t offset = std::size_t(in[0]) | (std::size_t(in[1]) << 8);
+      in += 2;
+      std::size_t match = token & 15;
+      if (match == 15 && !length(match))
+        return false;
+      match += min_match;
+      if (offset == 0 || offset > std::size_t(op - out) || std::size_t(op_end - op) < match)
+        return false;
+      // An overlapping match repeats its last offset bytes: copy them, then multiples of them as the output grows
+      for (std::size_t k = 0; k < match;)
+      {
+        std::size_t period = (k + offset) / offset * offset;
+        std::size_t count = std::min(match - k, period);
+        std::memcpy(op + k, op + k - period, count);
+        k += count;
+      }
+      op += match;
+    }
+    return op == op_end;
+  }
+} // namespace dmgmt
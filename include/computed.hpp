@@ -0,0 +1,340 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <cassert>
+#include <cstdint>
+
+#include "custom_type_utilities.hpp"
+#include "dependency_graph.hpp"
+
+namespace dmgmt
+{
+  class ComputedGraph;
+
+  /**
+   * @brief A value computed from elements and other computed values, see ComputedGraph
+   */
+  class ComputedNodeBase
+  {
+  public:
+    virtual ~ComputedNodeBase() = default;
+
+    /**
+     * @brief Whether an input may have changed since the value was last computed
+     */
+    bool stale() const { return mStale; }
+
+  protected:
+    explicit ComputedNodeBase(ComputedGraph &graph)
+        : pGraph{&graph}
+    {
+    }
+
+    /**
+     * @brief Computes the value from the inputs
+     * @return Whether the value changed
+     */
+    virtual bool compute() = 0;
+
+    ComputedGraph *pGraph;
+
+  private:
+    friend class ComputedGraph;
+
+    std::vector<ComputedNodeBase *> mInputs;                // Computed values it is computed from
+    std::vector<ComputedNodeBase *> mDependants;            // Computed values computed from it
+    std::vector<DependencyGraph::hook_iter_t> mWatches; // Hooks marking it dirty when an element input changes
+    std::uint64_t mChangedAt = 0;                           // Revision at which the value last changed
+    std::uint64_t mVerifiedAt = 0;                          // Revision at which the value was last known up to date
+    bool mDirty = true;                                     // An element input changed, or it was never computed
+    bool mStale = true;                                     // Dirty, or a computed input may have changed
+  };
+
+  /**
+   * @brief A computed value of type T, memoized between computations
+   */
+  template <typename T>
+  class ComputedValue : public ComputedNodeBase
+  {
+  public:
+    /**
+     * @brief Returns the value, computed again first if an input changed
+     */
+    const T &get();
+
+  protected:
+    using ComputedNodeBase::ComputedNodeBase;
+
+    /**
+     * @brief Stores a newly computed value
+     * @return Whether it differs from the previous one, values that cannot be compared always differ (see same_value)
+     */
+    bool store(T &&value)
+    {
+      if (mValue && same_value(*mValue, value))
+        return false;
+      mValue.emplace(std::move(value));
+      return true;
+    }
+
+  private:
+    std::optional<T> mValue;
+  };
+
+  /**
+   * @brief Handle of a computed value, reading it computes it if needed
+   */
+  template <typename T>
+  class Computed
+  {
+  public:
+    Computed() = default;
+
+    const T &get() const { return pNode->get(); }
+    const T &operator*() const { return get(); }
+    const T *operator->() const { return &get(); }
+
+    /**
+     * @brief Whether the next read may compute the value again
+     */
+    bool stale() const { return pNode->stale(); }
+
+    bool valid() const { return pNode != nullptr; }
+
+  private:
+    friend class ComputedGraph;
+
+    explicit Computed(ComputedValue<T> *node)
+        : pNode{node}
+    {
+    }
+
+    ComputedValue<T> *pNode = nullptr;
+  };
+
+  template <typename T>
+  struct is_computed : std::false_type
+  {
+  };
+
+  template <typename T>
+  struct is_computed<Computed<T>> : std::true_type
+  {
+  };
+
+  template <typename T>
+  inline constexpr bool is_computed_v = is_computed<T>::value;
+
+  /**
+   * @brief How an input of a computed value is held & read: elements by address, computed values by handle
+   */
+  template <typename In_t>
+  struct computed_input
+  {
+    using held_t = const In_t *;
+
+    static held_t hold(const In_t &input) { return &input; }
+    static const In_t &read(held_t input) { return *input; }
+  };
+
+  template <typename T>
+  struct computed_input<Computed<T>>
+  {
+    using held_t = Computed<T>;
+
+    static held_t hold(const Computed<T> &input) { return input; }
+    static const T &read(const held_t &input) { return input.get(); }
+  };
+
+  template <typename Compute_t, typename... Inputs_t>
+  using computed_result_t = std::decay_t<std::invoke_result_t<
+      Compute_t &, decltype(computed_input<Inputs_t>::read(std::declval<typename computed_input<Inputs_t>::held_t>()))...>>;
+
+  template <typename T, typename Compute_t, typename... Inputs_t>
+  class ComputedNode final : public ComputedValue<T>
+  {
+  public:
+    ComputedNode(ComputedGraph &graph, Compute_t compute, const Inputs_t &... inputs)
+        : ComputedValue<T>{graph},
+          mCompute{std::move(compute)},
+          mArguments{computed_input<Inputs_t>::hold(inputs)...}
+    {
+    }
+
+  private:
+    bool compute() override
+    {
+      return this->store(std::apply(
+          [this](const auto &... arguments) {
+            return T(mCompute(computed_input<Inputs_t>::read(arguments)...));
+          },
+          mArguments));
+    }
+
+    Compute_t mCompute;
+    std::tuple<typename computed_input<Inputs_t>::held_t...> mArguments;
+  };
+
+  /**
+   * @brief Values computed lazily from elements and other computed values.
+   *
+   * A change of an element input only marks its computed values dirty, and the values computed from them stale.
+   * A stale value is brought up to date when it is read: its stale inputs are brought up to date first,
+   * then it is computed again if it is dirty or if one of its inputs changed since it was last computed.
+   * A value computed again that is the same as before keeps its revision,
+   * so the values computed from it are not computed again (early cutoff).
+   */
+  class ComputedGraph
+  {
+  public:
+    ComputedGraph() = default;
+
+    ComputedGraph(const ComputedGraph &) = delete;
+    ComputedGraph &operator=(const ComputedGraph &) = delete;
+
+    /**
+     * @param watch Callable with DependencyGraph::hook_iter_t(const El_t &input, ComputedNodeBase &node) signature,
+     * registering a hook that calls invalidate(node) when an element input changes
+     * @param compute Function computing the value from the inputs, the value of computed inputs
+     * @param inputs Elements or Computed handles
+     */
+    template <typename Watch_t, typename Compute_t, typename... Inputs_t>
+    Computed<computed_result_t<Compute_t, Inputs_t...>> add(const Watch_t &watch, Compute_t compute, const Inputs_t &... inputs)
+    {
+      using T = computed_result_t<Compute_t, Inputs_t...>;
+      auto node = std::make_unique<ComputedNode<T, Compute_t, Inputs_t...>>(*this, std::move(compute), inputs...);
+      ComputedNodeBase &base = *node;
+      mNodes.push_back(std::move(node));
+      (link(base, watch, inputs), ...);
+      return Computed<T>{static_cast<ComputedValue<T> *>(&base)};
+    }
+
+    /**
+     * @brief Drops a computed value, no other computed value may be computed from it
+     * @param unwatch Callable with void(const DependencyGraph::hook_iter_t &) signature, removing a hook registered by watch
+     */
+    template <typename T, typename Unwatch_t>
+    void remove(const Computed<T> &computed, const Unwatch_t &unwatch)
+    {
+      ComputedNodeBase *node = computed.pNode;
+      assert("other computed values are computed from this one" && node->mDependants.empty());
+      for (const DependencyGraph::hook_iter_t &hook : node->mWatches)
+        unwatch(hook);
+      for (ComputedNodeBase *input : node->mInputs)
+        input->mDependants.erase(std::find(input->mDependants.begin(), input->mDependants.end(), node));
+      mNodes.erase(std::find_if(mNodes.begin(), mNodes.end(),
+                                [node](const std::unique_ptr<ComputedNodeBase> &held) { return held.get() == node; }));
+    }
+
+    std::size_t size() const { return mNodes.size(); }
+
+    /**
+     * @brief Marks a computed value dirty after one of its element inputs changed, and the values computed from it stale
+     */
+    void invalidate(ComputedNodeBase &node)
+    {
+      node.mDirty = true;
+      if (node.mStale) // The values computed from it are stale already
+        return;
+      node.mStale = true;
+      mMarking.push_back(&node);
+      while (!mMarking.empty())
+      {
+        ComputedNodeBase *marked = mMarking.back();
+        mMarking.pop_back();
+        for (ComputedNodeBase *dependant : marked->mDependants)
+          if (!dependant->mStale)
+          {
+            dependant->mStale = true;
+            mMarking.push_back(dependant);
+          }
+      }
+    }
+
+    /**
+     * @brief Brings a computed value up to date, its computed inputs first
+     */
+    void refresh(ComputedNodeBase &root)
+    {
+      if (!root.mStale)
+        return;
+      std::size_t base = mFrames.size(); // A computation may read other computed values
+      mFrames.push_back({&root, 0});
+      try
+      {
+        while (mFrames.size() > base) // Iterative depth first search, deep chains would overflow the call stack
+        {
+          ComputedNodeBase &node = *mFrames.back().node;
+          if (mFrames.back().next < node.mInputs.size())
+          {
+            ComputedNodeBase &input = *node.mInputs[mFrames.back().next++];
+            if (input.mStale)
+              mFrames.push_back({&input, 0});
+            continue;
+          }
+          mFrames.pop_back();
+          bool outdated = node.mDirty;
+          for (const ComputedNodeBase *input : node.mInputs)
+            outdated = outdated || input->mChangedAt > node.mVerifiedAt;
+          if (outdated && node.compute())
+            node.mChangedAt = ++mRevision;
+          node.mVerifiedAt = mRevision;
+          node.mDirty = node.mStale = false;
+        }
+      }
+      catch (...)
+      {
+        mFrames.resize(base);
+        throw;
+      }
+    }
+
+  private:
+    struct Frame
+    {
+      ComputedNodeBase *node;
+      std::size_t next; // Index of the next input to bring up to date
+    };
+
+    template <typename Watch_t, typename In_t>
+    void link(ComputedNodeBase &node, const Watch_t &watch, const In_t &input)
+    {
+      node.mWatches.push_back(watch(input, node));
+    }
+
+    template <typename Watch_t, typename T>
+    void link(ComputedNodeBase &node, const Watch_t &, const Computed<T> &input)
+    {
+      node.mInputs.push_back(input.pNode);
+      input.pNode->mDependants.push_back(&node);
+    }
+
+    std::vector<std::unique_ptr<ComputedNodeBase>> mNodes;
+    std::uint64_t mRevision = 0;
+    std::vector<ComputedNodeBase *> mMarking;
+    std::vector<Frame> mFrames;
+  };
+
+  template <typename T>
+  const T &ComputedValue<T>::get()
+  {
+    pGraph->refresh(*this);
+    return *mValue;
+  }
+} // namespace dmgmt
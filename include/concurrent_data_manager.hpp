@@ -0,0 +1,563 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#pragma once
+
+#include <atomic>
+#include <bitset>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include "async_dispatcher.hpp"
+#include "dependency_graph.hpp"
+#include "history.hpp"
+#include "propagation_plan.hpp"
+#include "signature.hpp"
+#include "snapshot.hpp"
+
+namespace dmgmt
+{
+  /**
+   * @brief A DataManager whose methods can be called from several threads.
+   *
+   * The contained data is split in regions of RegionSize bytes, mapped to Stripes reader/writer locks.
+   * A change only locks the stripes covering the changed element, so that writers to disjoint sub-objects
+   * of the data proceed in parallel. The previous value of the element is copied while the element is locked,
+   * then the change is appended to the undo/redo history under a short dedicated lock.
+   * Undo & redo lock every stripe.
+   *
+   * Callbacks are called by the thread that made the change, once the element & graph locks are released,
+   * with a copy of their element loaded under its locks: a callback reading other elements that other threads
+   * may be writing must read them with load(). Elements that cannot be copied are handed to their callbacks
+   * under their locks instead, such callbacks must not change the elements sharing these stripes.
+   * Callbacks may change elements, and register or remove callbacks or dependencies.
+   * A removed callback may still be called by the propagations that started before its removal.
+   *
+   * Changes are not grouped: each set/call is its own undo/redo entry, stored as full snapshots.
+   *
+   * @tparam Data_t Type of the contained & manageable data
+   * @tparam Stripes Number of locks the data is sharded over
+   * @tparam RegionSize Number of bytes covered by a lock stripe, before wrapping around
+   */
+  template <typename Data_t, std::size_t Stripes = 64, std::size_t RegionSize = 64>
+  class ConcurrentDataManager
+  {
+  public:
+    using callback_iter_t = DependencyGraph::callback_iter_t;
+    using dependency_iter_t = DependencyGraph::dependency_iter_t;
+
+    ConcurrentDataManager() = default;
+
+    /**
+     * @param history_resource Memory resource the undo/redo history is allocated from
+     */
+    explicit ConcurrentDataManager(std::pmr::memory_resource *history_resource)
+        : mHistory{history_resource}
+    {
+    }
+
+    /**
+     * @brief Returns a const reference to the data stored in the manager.
+     * This is to be used for set & call methods first argument.
+     */
+    const Data_t &get() { return mData; }
+
+    /**
+     * @brief Returns a copy of an element, read while no other thread writes to it
+     */
+    template <typename El_t>
+    El_t load(const El_t &element)
+    {
+      assert("element cannot be accessed by DataManager!!" && isValidMemory(element));
+      RegionLock<false> lock{*this, _stripes(element)};
+      return element;
+    }
+
+    /**
+     * @brief Registers a callback that will be called on every element change via set/call methods calls
+     * @param element Element linked to the callback
+     * @param fun Function to be called
+     * @param dispatch CallbackDispatch::Async to have the callback called by a worker thread rather than by the thread
+     * that made the change. Either way it is called with a copy of the element loaded under its locks
+     * @return Iterator to the registered callback
+     * @throw std::invalid_argument if dispatch is CallbackDispatch::Async and the element cannot be copied
+     */
+    template <typename El_t, typename Functor_t>
+    callback_iter_t register_callback(const El_t &element, const Functor_t &functor,
+                                      CallbackDispatch dispatch = CallbackDispatch::Sync)
+    {
+      assert("element cannot be accessed by DataManager!!" && isValidMemory(element));
+      std::unique_lock<std::shared_mutex> lock{mGraphMutex};
+      if constexpr (std::is_copy_constructible_v<El_t>)
+      {
+        if (dispatch == CallbackDispatch::Async)
+        {
+          if (!pDispatcher)
+            pDispatcher = std::make_unique<AsyncDispatcher>();
+          // The copy is made after the element locks are released: load it under them
+          return mGraph.register_callback(
+              element, pDispatcher->template wrap<El_t>(functor, [this](const El_t &changed) { return load(changed); }));
+        }
+      }
+      else if (dispatch == CallbackDispatch::Async)
+        throw std::invalid_argument("asynchronous callbacks need copyable elements");
+      if constexpr (std::is_copy_constructible_v<El_t>)
+        return mGraph.register_callback(element, [this, functor](const El_t &changed) { functor(load(changed)); });
+      else
+        return mGraph.register_callback(element, [this, functor](const El_t &changed) {
+          RegionLock<false> lock{*this, _stripes(changed)};
+          functor(changed);
+        });
+    }
+
+    /**
+     * @brief Removes all callback associated with an element
+     * @param element Element associated to the callbacks to be removed
+     */
+    template <typename El_t>
+    void remove_callback(const El_t &element)
+    {
+      std::unique_lock<std::shared_mutex> lock{mGraphMutex};
+      _retiring();
+      mGraph.remove_callback(element);
+    }
+
+    /**
+     * @brief Removes a callback
+     * @param iterator Callback iterator
+     */
+    void remove_callback(callback_iter_t iterator)
+    {
+      std::unique_lock<std::shared_mutex> lock{mGraphMutex};
+      _retiring();
+      mGraph.remove_callback(iterator);
+    }
+
+    /**
+     * @brief Registers a dependency between two elements.
+     * Every child element change via 'set' or 'call' methods will trigger parent element callbacks recursively.
+     * @param child Trigger element
+     * @param parent Element which callbacks will be triggered subsequently to child change
+     * @return Iterator to the registered dependency
+     */
+    template <typename Child_t, typename Parent_t>
+    dependency_iter_t register_dependency(const Child_t &child, const Parent_t &parent)
+    {
+      assert("child cannot be accessed by DataManager!!" && isValidMemory(child));
+      assert("parent cannot be accessed by DataManager!!" && isValidMemory(parent));
+      std::unique_lock<std::shared_mutex> lock{mGraphMutex};
+      return mGraph.register_dependency(child, parent);
+    }
+
+    /**
+     * @brief Removes all dependencies associated with an element
+     * @param element Element associated to the dependencies to be removed
+     */
+    template <typename El_t>
+    void remove_dependency(const El_t &element)
+    {
+      std::unique_lock<std::shared_mutex> lock{mGraphMutex};
+      mGraph.remove_dependency(element);
+    }
+
+    /**
+     * @brief Removes a dependency
+     * @param iterator Dependency iterator
+     */
+    void remove_dependency(dependency_iter_t iterator)
+    {
+      std::unique_lock<std::shared_mutex> lock{mGraphMutex};
+      mGraph.remove_dependency(iterator);
+    }
+
+    /**
+     * @brief Enables or disables containment dependencies, disabled by default.
+     * When enabled, a change to a member of the managed data also triggers the callbacks of every enclosing member
+     * that has callbacks registered, up to the data itself, without registering dependencies.
+     */
+    void set_containment_dependencies(bool enabled)
+    {
+      std::unique_lock<std::shared_mutex> lock{mGraphMutex};
+      mGraph.set_containment(enabled);
+    }
+
+    /**
+     * @brief Sets an element to a given value then calls callbacks & dependencies associated to this element.
+     * Nothing is recorded nor called if the element already has this value (see same_value).
+     * @param element Element to be set
+     * @param value New element value
+     */
+    template <typename El_t>
+    void set(const El_t &element, const El_t &value)
+    {
+      assert("element cannot be accessed by DataManager!!" && isValidMemory(element));
+      El_t &target = const_cast<El_t &>(element);
+      {
+        RegionLock<true> lock{*this, _stripes(element)};
+        if (same_value(target, value))
+          return;
+        El_t before = target;
+        target = value;
+        _record(std::move(before), target);
+      }
+      _propagate(element);
+    }
+
+    /**
+     * @brief Calls an element non const method then calls callbacks & dependencies associated to this element.
+     * Nothing is recorded nor called if the method leaves the element unchanged, for elements that can be compared as by same_value.
+     * @param element Element from which the method is called
+     * @param method Pointer to one of the element's method
+     * @param args Method arguments, forwarded to the method
+     * @return Return value of the method
+     */
+    template <typename El_t, typename Ret_t, typename... Params_t, typename... Args_t>
+    Ret_t call(const El_t &element, Ret_t (El_t::*method)(Params_t...), Args_t &&... args)
+    {
+      assert("element cannot be accessed by DataManager!!" && isValidMemory(element));
+      El_t &target = const_cast<El_t &>(element);
+      if constexpr (std::is_void_v<Ret_t>)
+      {
+        {
+          RegionLock<true> lock{*this, _stripes(element)};
+          El_t before = target;
+          (target.*method)(std::forward<Args_t>(args)...);
+          if (same_value(before, target))
+            return;
+          _record(std::move(before), target);
+        }
+        _propagate(element);
+      }
+      else
+      {
+        std::optional<Ret_t> result;
+        {
+          RegionLock<true> lock{*this, _stripes(element)};
+          El_t before = target;
+          result.emplace((target.*method)(std::forward<Args_t>(args)...));
+          if (same_value(before, target))
+            return std::move(*result);
+          _record(std::move(before), target);
+        }
+        _propagate(element);
+        return std::move(*result);
+      }
+    }
+
+    /**
+     * @brief Sets the number of worker threads calling asynchronous callbacks, hardware concurrency by default.
+     * Must be called before the first asynchronous callback is registered: callbacks hold on to their workers.
+     * @throw std::logic_error if the workers are already started
+     */
+    void set_async_workers(std::size_t count)
+    {
+      std::unique_lock<std::shared_mutex> lock{mGraphMutex};
+      if (pDispatcher)
+        throw std::logic_error("asynchronous workers already started");
+      pDispatcher = std::make_unique<AsyncDispatcher>(count);
+    }
+
+    /**
+     * @brief Blocks until every queued asynchronous callback has returned
+     */
+    void wait_async()
+    {
+      std::shared_lock<std::shared_mutex> lock{mGraphMutex};
+      if (pDispatcher)
+        pDispatcher->wait();
+    }
+
+    /**
+     * @brief Queue depth & dispatch latency of the asynchronous callbacks
+     */
+    DispatchStats dispatch_stats()
+    {
+      std::shared_lock<std::shared_mutex> lock{mGraphMutex};
+      if (pDispatcher)
+        return pDispatcher->stats();
+      return {0, 0, std::chrono::nanoseconds{0}, std::chrono::nanoseconds{0}, 0};
+    }
+
+    /**
+     * @brief Bounds the undo/redo history, the oldest changes are forgotten first
+     * @param max_entries Maximum number of undoable changes
+     * @param max_bytes Maximum number of bytes used to store the changes
+     */
+    void set_history_limits(std::size_t max_entries, std::size_t max_bytes)
+    {
+      std::lock_guard<std::mutex> lock{mHistoryMutex};
+      mHistory.set_limits(max_entries, max_bytes);
+    }
+
+    /**
+     * @brief Compresses the changes that are more than a number of undo steps old, they are decompressed when undone or redone.
+     * Applies to trivially copyable elements of at least compress_min_size bytes changed from now on.
+     * @param depth Number of most recent changes kept uncompressed, History::uncompressed to stop compressing
+     */
+    void set_history_compression(std::size_t depth)
+    {
+      std::lock_guard<std::mutex> lock{mHistoryMutex};
+      mHistory.set_compression_depth(depth);
+    }
+
+    /**
+     * @brief Spills the changes the history limits evict to a memory mapped journal file instead of forgetting them,
+     * they are paged back in when undone. Register the serializers of the non trivially copyable elements
+     * on the journal before handing it over.
+     * @param journal Journal to spill to, nullptr to forget evicted changes again
+     */
+    void set_undo_journal(std::unique_ptr<UndoJournal> journal)
+    {
+      std::lock_guard<std::mutex> lock{mHistoryMutex};
+      mHistory.set_journal(std::move(journal));
+    }
+
+    /**
+     * @brief Memory currently used by the undo/redo history
+     */
+    HistoryUsage history_usage()
+    {
+      std::lock_guard<std::mutex> lock{mHistoryMutex};
+      return mHistory.usage();
+    }
+
+    /**
+     * @brief Undoes last change, calls all appropriate callbacks & dependencies
+     * @return true if undo was done else false
+     */
+    bool undo()
+    {
+      std::vector<Signature> changed;
+      bool done;
+      {
+        RegionLock<true> lock{*this, std::bitset<Stripes>{}.set()};
+        std::lock_guard<std::mutex> history{mHistoryMutex};
+        done = mHistory.undo([&](const Signature &ds) { changed.push_back(ds); });
+      }
+      _propagate(changed);
+      return done;
+    }
+
+    /**
+     * @brief Redoes last change, calls all appropriate callbacks & dependencies
+     * @return true if redo was done else false
+     */
+    bool redo()
+    {
+      std::vector<Signature> changed;
+      bool done;
+      {
+        RegionLock<true> lock{*this, std::bitset<Stripes>{}.set()};
+        std::lock_guard<std::mutex> history{mHistoryMutex};
+        done = mHistory.redo([&](const Signature &ds) { changed.push_back(ds); });
+      }
+      _propagate(changed);
+      return done;
+    }
+
+  private:
+    /**
+     * @brief Locks a set of stripes in increasing order, so that two locks never wait for each other
+     * @tparam Exclusive true to lock for writing, false for reading
+     */
+    template <bool Exclusive>
+    class RegionLock
+    {
+    public:
+      RegionLock(ConcurrentDataManager &manager, const std::bitset<Stripes> &stripes)
+          : pManager{&manager}, mStripes{stripes}
+      {
+        for (std::size_t i = 0; i < Stripes; ++i)
+          if (mStripes[i])
+          {
+            if constexpr (Exclusive)
+              pManager->mStripes[i].mutex.lock();
+            else
+              pManager->mStripes[i].mutex.lock_shared();
+          }
+      }
+
+      RegionLock(const RegionLock &) = delete;
+      RegionLock &operator=(const RegionLock &) = delete;
+
+      ~RegionLock()
+      {
+        for (std::size_t i = Stripes; i-- > 0;)
+          if (mStripes[i])
+          {
+            if constexpr (Exclusive)
+              pManager->mStripes[i].mutex.unlock();
+            else
+              pManager->mStripes[i].mutex.unlock_shared();
+          }
+      }
+
+    private:
+      ConcurrentDataManager *pManager;
+      std::bitset<Stripes> mStripes;
+    };
+
+    /**
+     * @brief A lock on its own cache line, so that threads locking neighbouring stripes do not contend
+     */
+    struct alignas(64) Stripe
+    {
+      std::shared_mutex mutex;
+    };
+
+    /**
+     * @brief Returns the stripes covering the bytes of an element
+     */
+    template <typename El_t>
+    std::bitset<Stripes> _stripes(const El_t &element) const
+    {
+      std::bitset<Stripes> stripes;
+      std::size_t offset = std::size_t(&element) - std::size_t(&mData);
+      std::size_t first = offset / RegionSize;
+      std::size_t last = (offset + sizeof(El_t) - 1) / RegionSize;
+      if (last - first + 1 >= Stripes)
+        return stripes.set();
+      for (std::size_t region = first; region <= last; ++region)
+        stripes.set(region % Stripes);
+      return stripes;
+    }
+
+    /**
+     * @brief Appends a change to the undo/redo history as a new entry
+     */
+    template <typename El_t>
+    void _record(El_t &&before, El_t &element)
+    {
+      std::lock_guard<std::mutex> lock{mHistoryMutex};
+      mHistory.record(mHistory.push(), std::move(before), element);
+    }
+
+    /**
+     * @brief Calls alls callbacks linked to an element and its dependants, from the cached plan of the element
+     */
+    void _propagate(const Signature &sig)
+    {
+      PropagationPlan steps;
+      {
+        std::shared_lock<std::shared_mutex> graph{mGraphMutex};
+        const PropagationPlan *plan = mGraph.find_plan(sig);
+        while (!plan) // Compile it, unless the graph changed in between
+        {
+          graph.unlock();
+          {
+            std::unique_lock<std::shared_mutex> compile{mGraphMutex};
+            mGraph.plan(sig);
+          }
+          graph.lock();
+          plan = mGraph.find_plan(sig);
+        }
+        if (plan->empty())
+          return;
+        steps = *plan;
+        mPropagations.fetch_add(1);
+      }
+      _invoke(steps);
+    }
+
+    /**
+     * @brief Calls once all callbacks linked to several changed elements and their dependants
+     */
+    void _propagate(const std::vector<Signature> &changed)
+    {
+      PropagationPlan steps;
+      {
+        std::unique_lock<std::shared_mutex> graph{mGraphMutex};
+        mGraph.compile(changed.begin(), changed.end(), steps);
+        if (steps.empty())
+          return;
+        mPropagations.fetch_add(1);
+      }
+      _invoke(steps);
+    }
+
+    /**
+     * @brief Calls the steps of a plan copied by a propagation counted in mPropagations, without holding the graph lock,
+     * so that callbacks can change elements or the graph
+     */
+    void _invoke(const PropagationPlan &steps)
+    {
+      struct Counted // Ends the propagation even if a callback throws
+      {
+        ~Counted() { pManager->_propagated(); }
+        ConcurrentDataManager *pManager;
+      } counted{this};
+      for (const PropagationStep &step : steps)
+        step.callback->invoke(step.element);
+    }
+
+    /**
+     * @brief Stops counting a propagation, unpins the graph after the last one
+     */
+    void _propagated()
+    {
+      if (mPropagations.fetch_sub(1) == 1 && mPinned.load())
+      {
+        std::unique_lock<std::shared_mutex> graph{mGraphMutex};
+        if (mPinned.load() && !mPropagations.load())
+        {
+          mPinned.store(false);
+          mGraph.unpin();
+        }
+      }
+    }
+
+    /**
+     * @brief Called with the graph locked before removing callbacks: the graph keeps them alive
+     * until the propagations that may still call them end
+     */
+    void _retiring()
+    {
+      if (mPinned.load())
+        return;
+      mPinned.store(true); // Before checking the count, so that the last propagation ending after sees the pin
+      if (mPropagations.load())
+        mGraph.pin();
+      else
+        mPinned.store(false);
+    }
+
+    /**
+     * @brief Check whether an element belongs to the stored data structure
+     */
+    template <typename El_t>
+    bool isValidMemory(const El_t &element)
+    {
+      return size_t(&element) >= size_t(&mData) && std::size_t(&element + 1) <= std::size_t(&mData + 1);
+    }
+
+    Data_t mData;
+    Stripe mStripes[Stripes];
+
+    DependencyGraph mGraph;
+    std::shared_mutex mGraphMutex; // Registration & plan compilation are exclusive, copying plans is shared
+    std::atomic<std::size_t> mPropagations{0}; // Propagations calling copied plan steps
+    std::atomic<bool> mPinned{false};          // Whether the graph is pinned for these propagations
+
+    History mHistory;
+    std::mutex mHistoryMutex;
+
+    std::unique_ptr<AsyncDispatcher> pDispatcher; // Last member: queued callbacks are waited for first
+  };
+} // namespace dmgmt
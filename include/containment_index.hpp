@@ -0,0 +1,138 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "signature.hpp"
+
+namespace dmgmt
+{
+  /**
+   * @brief An index of the [address, address + size) byte ranges of a set of elements,
+   * answering which element most closely encloses another one.
+   *
+   * Elements of a data structure are either nested or disjoint (the ranges form a laminar family):
+   * the ranges are sorted by start address, each one linked to its closest enclosing range.
+   * The elements enclosing a given range are then a chain of parents, starting from the last range
+   * that starts before it. Elements sharing the same range (a structure & its only member) cannot be told apart
+   * by their bytes: they form a group whose members enclose each other, sorted by type & linked to the same parent.
+   */
+  class ContainmentIndex
+  {
+  public:
+    void insert(const Signature &sig)
+    {
+      std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(sig.address());
+      mRanges.push_back({begin, begin + sig.size(), sig, npos});
+      mSorted = false;
+    }
+
+    void erase(const Signature &sig)
+    {
+      mRanges.erase(std::remove_if(mRanges.begin(), mRanges.end(),
+                                   [&](const Range &range) { return range.element == sig; }),
+                    mRanges.end());
+      mSorted = false;
+    }
+
+    void clear()
+    {
+      mRanges.clear();
+      mSorted = true;
+    }
+
+    std::size_t size() const { return mRanges.size(); }
+
+    /**
+     * @brief Calls a function with the closest indexed elements, other than sig, whose range encloses the range of sig:
+     * the elements sharing the range of sig, then the closest element whose range is larger.
+     * @param output a functor with void(const Signature &) signature
+     */
+    template <typename Output_t>
+    void enclosing(const Signature &sig, const Output_t &output)
+    {
+      if (!mSorted)
+        sort();
+      std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(sig.address());
+      std::uintptr_t end = begin + sig.size();
+      auto after = std::upper_bound(mRanges.begin(), mRanges.end(), begin,
+                                    [](std::uintptr_t address, const Range &range) { return address < range.begin; });
+      std::size_t index = after == mRanges.begin() ? npos : std::size_t(after - mRanges.begin()) - 1;
+      while (index != npos && mRanges[index].end < end)
+        index = mRanges[index].parent;
+      if (index == npos)
+        return;
+      if (mRanges[index].begin < begin || mRanges[index].end > end)
+        return output(mRanges[index].element);
+
+      // A group is contiguous once sorted
+      std::size_t first = index;
+      while (first > 0 && same_range(mRanges[first - 1], mRanges[index]))
+        --first;
+      for (std::size_t i = first; i < mRanges.size() && same_range(mRanges[i], mRanges[index]); ++i)
+        if (mRanges[i].element != sig)
+          output(mRanges[i].element);
+      if (mRanges[index].parent != npos)
+        output(mRanges[mRanges[index].parent].element);
+    }
+
+  private:
+    static constexpr std::size_t npos = ~std::size_t(0);
+
+    struct Range
+    {
+      std::uintptr_t begin;
+      std::uintptr_t end;
+      Signature element;
+      std::size_t parent; // Index of the closest enclosing range
+    };
+
+    static bool same_range(const Range &lhs, const Range &rhs) { return lhs.begin == rhs.begin && lhs.end == rhs.end; }
+
+    /**
+     * @brief Sorts the ranges, enclosing ranges first & groups by type, then links each range
+     * to its closest enclosing range, the members of a group to the range enclosing the group
+     */
+    void sort()
+    {
+      std::sort(mRanges.begin(), mRanges.end(), [](const Range &lhs, const Range &rhs) {
+        if (lhs.begin != rhs.begin)
+          return lhs.begin < rhs.begin;
+        if (lhs.end != rhs.end)
+          return lhs.end > rhs.end;
+        return std::less<type_id_t>{}(lhs.element.type_id(), rhs.element.type_id());
+      });
+      mStack.clear();
+      for (std::size_t i = 0; i < mRanges.size(); ++i)
+      {
+        while (!mStack.empty() && mRanges[mStack.back()].end < mRanges[i].end)
+          mStack.pop_back();
+        if (mStack.empty())
+          mRanges[i].parent = npos;
+        else if (same_range(mRanges[mStack.back()], mRanges[i]))
+          mRanges[i].parent = mRanges[mStack.back()].parent;
+        else
+          mRanges[i].parent = mStack.back();
+        mStack.push_back(i);
+      }
+      mSorted = true;
+    }
+
+    std::vector<Range> mRanges;
+    std::vector<std::size_t> mStack;
+    bool mSorted = true;
+  };
+} // namespace dmgmt
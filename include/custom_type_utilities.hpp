@@ -10,7 +10,9 @@
 
 #pragma once
 
+#include <cstring>
 #include <type_traits>
+#include <typeinfo>
 #include <cstddef>
 
 namespace dmgmt
@@ -72,6 +74,36 @@ namespace dmgmt
   template <typename T, typename... Types>
   constexpr std::size_t get_type_index_v = get_type_index<T, Types...>::value;
 
+  template <typename... Types>
+  struct type_list
+  {
+    static constexpr std::size_t size = sizeof...(Types);
+  };
+
+  /**
+   * @brief Appends the types of Types that are not already among the list types
+   */
+  template <typename List, typename... Types>
+  struct append_unique;
+
+  template <typename... Listed>
+  struct append_unique<type_list<Listed...>>
+  {
+    typedef type_list<Listed...> type;
+  };
+
+  template <typename... Listed, typename T0, typename... Types>
+  struct append_unique<type_list<Listed...>, T0, Types...>
+  {
+    typedef typename append_unique<std::conditional_t<is_type_among_v<T0, Listed...>,
+                                                      type_list<Listed...>,
+                                                      type_list<Listed..., T0>>,
+                                   Types...>::type type;
+  };
+
+  template <typename List, typename... Types>
+  using append_unique_t = typename append_unique<List, Types...>::type;
+
   template <typename T, typename EqualTo>
   struct has_operator_equal_impl
   {
@@ -90,4 +122,48 @@ namespace dmgmt
 
   template <typename T, typename EqualTo = T>
   constexpr bool has_operator_equal_v = has_operator_equal<T, EqualTo>::value;
+
+  /**
+   * @brief Whether two values are known to be the same. Trivially copyable values are compared bytewise,
+   * with memcmp which compares whole vectors of bytes at a time: values that only differ by padding bytes are different.
+   * Other values are compared with operator==, values that have none are never the same.
+   */
+  template <typename T>
+  bool same_value(const T &lhs, const T &rhs)
+  {
+    if constexpr (std::is_trivially_copyable_v<T>)
+      return std::memcmp(&lhs, &rhs, sizeof(T)) == 0;
+    else if constexpr (has_operator_equal_v<T>)
+      return bool(lhs == rhs);
+    else
+    {
+      (void)lhs;
+      (void)rhs;
+      return false;
+    }
+  }
+
+  /**
+   * @brief Static description of a type. There is exactly one instance per type,
+   * hence its address can be used as a compact type identifier.
+   */
+  struct TypeInfo
+  {
+    const std::type_info &info;
+    std::size_t size;
+  };
+
+  using type_id_t = const TypeInfo *;
+
+  template <typename T>
+  struct type_info_of
+  {
+    static inline const TypeInfo value{typeid(T), sizeof(T)};
+  };
+
+  /**
+   * @brief Returns the compact identifier of type T
+   */
+  template <typename T>
+  constexpr type_id_t type_id() noexcept { return &type_info_of<T>::value; }
 } // namespace dmgmt
\ No newline at end of file
@@ -10,36 +10,146 @@
 
 #pragma once
 
+#include "mapped_storage.hpp"
+#include "state_checkpoints.hpp"
 #include "static_data_manager.hpp"
+#include "static_wiring.hpp"
 #include <cassert>
+#include <memory>
 
 namespace dmgmt
 {
   /**
-   * @brief An object containing a class/struct, that allows callback and dependency registration as well as undo/redo management
-   * @tparam Data_t Type of the contained & manageable data
+   * @brief Storage of the data of a DataManager, held by the manager
+   */
+  template <typename Data_t>
+  struct ManagedData
+  {
+    using data_t = Data_t;
+
+    ManagedData() : data{} {}
+
+    Data_t data;
+  };
+
+  /**
+   * @brief Storage of the data of a DataManager, held by a memory mapped file
    */
   template <typename Data_t>
+  struct ManagedData<Mapped<Data_t>>
+  {
+    using data_t = Data_t;
+
+    explicit ManagedData(std::unique_ptr<MappedStorage<Data_t>> storage)
+        : pStorage{std::move(storage)},
+          data{pStorage->data()}
+    {
+    }
+
+    std::unique_ptr<MappedStorage<Data_t>> pStorage;
+    Data_t &data;
+  };
+
+  /**
+   * @brief An object containing a class/struct, that allows callback and dependency registration as well as undo/redo management
+   * @tparam Stored_t Type of the contained & manageable data, or Mapped<Data_t> to keep it in a memory mapped file
+   * @tparam Wiring Callbacks & dependencies known at compile time, as Callback & Depends declarations.
+   * Statically wired elements changed with set<Path>() call their callbacks directly, without any lookup.
+   */
+  template <typename Stored_t, typename... Wiring>
   class DataManager
   {
   public:
+    using Data_t = typename ManagedData<Stored_t>::data_t;
+    using state_id_t = StateCheckpoints::id_t;
+
+  private:
+    using wiring_t = StaticWiring<Data_t, Wiring...>;
+    static constexpr bool mapped = !std::is_same_v<Data_t, Stored_t>; // Held by a MappedStorage
+
+  public:
+    DataManager()
+    {
+      wiring_t::register_into(mManager, mStored.data);
+      mWiredRevision = mManager.graph_revision();
+    }
+
+    /**
+     * @param history_resource Memory resource the undo/redo history is allocated from
+     */
+    explicit DataManager(std::pmr::memory_resource *history_resource)
+        : mManager{history_resource}
+    {
+      wiring_t::register_into(mManager, mStored.data);
+      mWiredRevision = mManager.graph_revision();
+    }
+
+    /**
+     * @brief Manages data living in a memory mapped file, for a DataManager<Mapped<Data_t>>: the data is the one
+     * the file holds, left by a previous process or recovered from its last checkpoint. The undo/redo history starts empty.
+     * @param storage Storage of the data, Data_t must be trivially copyable
+     * @param history_resource Memory resource the undo/redo history is allocated from
+     */
+    explicit DataManager(std::unique_ptr<MappedStorage<Data_t>> storage,
+                         std::pmr::memory_resource *history_resource = std::pmr::get_default_resource())
+        : mStored{std::move(storage)},
+          mManager{history_resource}
+    {
+      static_assert(mapped, "only a DataManager<Mapped<Data_t>> is constructed from a MappedStorage");
+      wiring_t::register_into(mManager, mStored.data);
+      mWiredRevision = mManager.graph_revision();
+    }
+
+    DataManager(const DataManager &) = delete;
+    DataManager &operator=(const DataManager &) = delete;
+
     /**
      * @brief Returns a const reference to the data stored in the manager.
      * This is to be used for set & call methods first argument.
      */
-    const Data_t &get() { return mData; }
+    const Data_t &get() { return mStored.data; }
+
+    /**
+     * @brief The memory mapped file holding the data, nullptr if the data is held by the manager
+     */
+    MappedStorage<Data_t> *mapped_storage() const
+    {
+      if constexpr (mapped)
+        return mStored.pStorage.get();
+      else
+        return nullptr;
+    }
+
+    /**
+     * @brief Copies the data to a checkpoint of its memory mapped file & waits until it is on disk.
+     * A process that did not close the file cleanly is restarted from the last checkpoint.
+     * @return false if the data is not held by a memory mapped file
+     */
+    bool checkpoint()
+    {
+      if constexpr (mapped)
+      {
+        mStored.pStorage->checkpoint();
+        return true;
+      }
+      else
+        return false;
+    }
 
     /**
      * @brief Registers a callback that will be called on every element change via DataManager set/call methods calls
      * @param element Element linked to the callback
      * @param fun Function to be called
+     * @param dispatch CallbackDispatch::Async to have the callback called by a worker thread, with a copy of the element
      * @return Iterator to the registered callback
+     * @throw std::invalid_argument if dispatch is CallbackDispatch::Async and the element cannot be copied
      */
     template <typename El_t, typename Functor_t>
-    StaticDataManager::callback_iter_t register_callback(const El_t &element, const Functor_t &functor)
+    StaticDataManager::callback_iter_t register_callback(const El_t &element, const Functor_t &functor,
+                                                         CallbackDispatch dispatch = CallbackDispatch::Sync)
     {
       assert("element cannot be accessed by DataManager!!" && isValidMemory(element));
-      return mManager.register_callback(element, functor);
+      return mManager.register_callback(element, functor, dispatch);
     }
 
     /**
@@ -61,6 +171,34 @@ namespace dmgmt
       mManager.remove_callback(iterator);
     }
 
+    /**
+     * @brief Registers a value computed from elements and other computed values, see StaticDataManager::register_computed
+     * @param compute Function computing the value, called with the inputs (the value of computed inputs)
+     * @param inputs Elements or Computed handles the value is computed from
+     * @return Handle reading the value
+     */
+    template <typename Compute_t, typename... Inputs_t>
+    auto register_computed(Compute_t compute, const Inputs_t &... inputs)
+    {
+      assert("element cannot be accessed by DataManager!!" && (isValidInput(inputs) && ...));
+      return mManager.register_computed(std::move(compute), inputs...);
+    }
+
+    /**
+     * @brief Removes a computed value, no other computed value may be computed from it
+     * @param computed Handle returned by register_computed
+     */
+    template <typename T>
+    void remove_computed(const Computed<T> &computed)
+    {
+      mManager.remove_computed(computed);
+    }
+
+    /**
+     * @brief The coroutines awaiting a change, see changed(manager, element) & set_change_scheduler(manager, scheduler)
+     */
+    ChangeWaiters &change_waiters() { return mManager.change_waiters(); }
+
     /**
      * @brief Registers a dependency between two elements.
      * Every child element change via 'set' or 'call' methods will trigger parent element callbacks recursively.
@@ -95,6 +233,15 @@ namespace dmgmt
       mManager.remove_dependency(iterator);
     }
 
+    /**
+     * @brief Enables or disables containment dependencies, disabled by default.
+     * When enabled, a change to a member of the managed data also triggers the callbacks of every enclosing member
+     * that has callbacks registered, up to the data itself, without registering dependencies.
+     */
+    void set_containment_dependencies(bool enabled) { mManager.set_containment_dependencies(enabled); }
+
+    bool containment_dependencies() const { return mManager.containment_dependencies(); }
+
     /**
      * @brief Sets an element to a given value then calls callbacks & dependencies associated to this element
      * @param element Element to be set
@@ -108,33 +255,221 @@ namespace dmgmt
       mManager.set(const_cast<El_t &>(element), value, groupWithLast);
     }
 
+    /**
+     * @brief Moves a value into an element then calls callbacks & dependencies associated to this element.
+     * The previous value is moved into the undo/redo history and the new value is only copied if the change is undone.
+     * @param element Element to be set
+     * @param value New element value
+     * @param groupWithLast set to true if this change needs to be grouped with the previous one in terms of undo/redo
+     */
+    template <typename El_t, typename = std::enable_if_t<!std::is_reference_v<El_t>>>
+    void set(const El_t &element, El_t &&value, bool groupWithLast = false)
+    {
+      assert("element cannot be accessed by DataManager!!" && isValidMemory(element));
+      mManager.set(const_cast<El_t &>(element), std::move(value), groupWithLast);
+    }
+
+    /**
+     * @brief Sets a statically wired element to a given value then calls the statically wired callbacks
+     * of this element and its dependants, in an order computed at compile time.
+     * The element is set like any other, through the run-time graph, if it is not wired, if propagation is deferred,
+     * or if the run-time graph holds more than the wiring (callbacks or dependencies registered or removed since
+     * construction, containment dependencies, computed values, awaited elements).
+     * @tparam Path_t Path of the element, e.g. Path<&Data_t::member>
+     * @param value New element value
+     * @param groupWithLast set to true if this change needs to be grouped with the previous one in terms of undo/redo
+     */
+    template <typename Path_t>
+    void set(const path_element_t<Data_t, Path_t> &value, bool groupWithLast = false)
+    {
+      if constexpr (wiring_t::template is_wired<Path_t>)
+        if (mManager.graph_revision() == mWiredRevision)
+          return mManager.set_wired(Path_t::resolve(mStored.data), value, groupWithLast,
+                                    [this]() { wiring_t::template propagate<Path_t>(mStored.data); });
+      mManager.set(Path_t::resolve(mStored.data), value, groupWithLast);
+    }
+
     /**
      * @brief Calls an element non const method then calls callbacks & dependencies associated to this element
      * @param element Element from which the method is called
      * @param method Pointer to one of the element's method
-     * @param args Method arguments
+     * @param args Method arguments, forwarded to the method
      * @return Return value of the method
      */
-    template <typename El_t, typename Ret_t, typename... Args_t>
-    Ret_t call(const El_t &element, Ret_t (El_t::*method)(Args_t...), const Args_t &... args)
+    template <typename El_t, typename Ret_t, typename... Params_t, typename... Args_t>
+    Ret_t call(const El_t &element, Ret_t (El_t::*method)(Params_t...), Args_t &&... args)
     {
       assert("element cannot be accessed by DataManager!!" && isValidMemory(element));
-      return mManager.call(const_cast<El_t &>(element), method, args...);
+      return mManager.call(const_cast<El_t &>(element), method, std::forward<Args_t>(args)...);
     }
 
     /**
      * @brief Calls an element non const method then calls callbacks & dependencies associated to this element
      * @param element Element from which the method is called
      * @param method Pointer to one of the element's method
-     * @param args Method arguments
+     * @param args Method arguments, forwarded to the method
      */
-    template <typename El_t, typename... Args_t>
-    void call(const El_t &element, void (El_t::*method)(Args_t...), const Args_t &... args)
+    template <typename El_t, typename... Params_t, typename... Args_t>
+    void call(const El_t &element, void (El_t::*method)(Params_t...), Args_t &&... args)
     {
       assert("element cannot be accessed by DataManager!!" && isValidMemory(element));
-      mManager.call(const_cast<El_t &>(element), method, args...);
+      mManager.call(const_cast<El_t &>(element), method, std::forward<Args_t>(args)...);
     }
 
+    /**
+     * @brief Sets how the values of elements changed from now on are stored in the undo/redo history.
+     * With SnapshotEncoding::Delta, trivially copyable elements of at least delta_min_size bytes
+     * only keep the byte ranges that changed.
+     */
+    void set_snapshot_encoding(SnapshotEncoding encoding) { mManager.set_snapshot_encoding(encoding); }
+
+    /**
+     * @brief Bounds the undo/redo history, the oldest changes are forgotten first
+     * @param max_entries Maximum number of undoable changes
+     * @param max_bytes Maximum number of bytes used to store the changes
+     */
+    void set_history_limits(std::size_t max_entries, std::size_t max_bytes) { mManager.set_history_limits(max_entries, max_bytes); }
+
+    /**
+     * @brief Compresses the changes that are more than a number of undo steps old, they are decompressed when undone or redone.
+     * Applies to trivially copyable elements of at least compress_min_size bytes changed from now on.
+     * @param depth Number of most recent changes kept uncompressed, History::uncompressed to stop compressing
+     */
+    void set_history_compression(std::size_t depth) { mManager.set_history_compression(depth); }
+
+    /**
+     * @brief Spills the changes the history limits evict to a memory mapped journal file instead of forgetting them,
+     * they are paged back in when undone. Register the serializers of the non trivially copyable elements
+     * on the journal before handing it over.
+     * @param journal Journal to spill to, nullptr to forget evicted changes again
+     */
+    void set_undo_journal(std::unique_ptr<UndoJournal> journal) { mManager.set_undo_journal(std::move(journal)); }
+
+    /**
+     * @brief Memory currently used by the undo/redo history
+     */
+    HistoryUsage history_usage() const { return mManager.history_usage(); }
+
+    /**
+     * @brief Saves the whole data in constant time. Chunks of the data are copied when they are first written
+     * by set/call/undo/redo after the call, chunks left untouched are never copied.
+     * @return Id of the saved state
+     */
+    state_id_t save_state()
+    {
+      static_assert(std::is_trivially_copyable_v<Data_t>, "saving the state requires trivially copyable data");
+      static_assert(sizeof(Data_t) <= StateCheckpoints::max_size, "saving the state requires data smaller than 4 GiB");
+      if (!pCheckpoints)
+      {
+        pCheckpoints = std::make_unique<StateCheckpoints>(&mStored.data, sizeof(Data_t));
+        mManager.set_write_hook([this](const Signature &sig) { pCheckpoints->before_write(sig.address(), sig.size()); });
+      }
+      return pCheckpoints->checkpoint();
+    }
+
+    /**
+     * @brief Brings the data back to a saved state by copying back the chunks written since,
+     * then calls the callbacks of the elements whose bytes differ & of their dependants.
+     * The saved state is kept, the states saved after it and the undo/redo history are dropped.
+     * @return false if there is no such state
+     */
+    bool restore_state(state_id_t id)
+    {
+      std::pmr::vector<ByteRange> changed;
+      if (!pCheckpoints || !pCheckpoints->restore(id, changed))
+        return false;
+      mManager.clear_history();
+      mManager.changed_memory(&mStored.data, changed);
+      return true;
+    }
+
+    /**
+     * @brief Drops a saved state
+     */
+    void release_state(state_id_t id)
+    {
+      if (pCheckpoints)
+        pCheckpoints->release(id);
+    }
+
+    /**
+     * @brief Hot path counters & latency histograms, recorded when DMGMT_ENABLE_INSTRUMENTATION is defined
+     */
+    const Instrumentation &instrumentation() const { return mManager.instrumentation(); }
+
+    void reset_instrumentation() { mManager.reset_instrumentation(); }
+
+    /**
+     * @brief Sets the number of worker threads calling asynchronous callbacks, hardware concurrency by default.
+     * Must be called before the first asynchronous callback is registered: callbacks hold on to their workers.
+     * @throw std::logic_error if the workers are already started
+     */
+    void set_async_workers(std::size_t count) { mManager.set_async_workers(count); }
+
+    /**
+     * @brief Blocks until every queued asynchronous callback has returned
+     */
+    void wait_async() const { mManager.wait_async(); }
+
+    /**
+     * @brief Queue depth & dispatch latency of the asynchronous callbacks
+     */
+    DispatchStats dispatch_stats() const { return mManager.dispatch_stats(); }
+
+    /**
+     * @brief Sets when callbacks are called. Switching to PropagationMode::Immediate flushes pending changes.
+     * In PropagationMode::Deferred, set/call/undo/redo only mark the changed elements,
+     * the undo/redo history is still recorded when the change is made.
+     */
+    void set_propagation_mode(PropagationMode mode) { mManager.set_propagation_mode(mode); }
+
+    PropagationMode propagation_mode() const { return mManager.propagation_mode(); }
+
+    /**
+     * @brief Calls once every callback linked to the elements changed since the last propagation & their dependants
+     */
+    void flush() { mManager.flush(); }
+
+    using Transaction = StaticDataManager::Transaction;
+
+    /**
+     * @brief Starts a transaction. Until it is committed, changes are recorded as a single undo/redo group
+     * and callbacks are not called. Transactions can be nested, only the outermost commit has an effect.
+     */
+    void begin_transaction() { mManager.begin_transaction(); }
+
+    /**
+     * @brief Commits a transaction: calls once every callback linked to the changed elements & their dependants
+     */
+    void commit_transaction() { mManager.commit_transaction(); }
+
+    /**
+     * @brief Starts a transaction committed at the end of the returned scope
+     */
+    [[nodiscard]] Transaction transaction() { return mManager.transaction(); }
+
+    /**
+     * @brief Sets when successive changes of the same element are merged into a single undo/redo entry
+     */
+    void set_coalescing_policy(const CoalescingPolicy &policy) { mManager.set_coalescing_policy(policy); }
+
+    const CoalescingPolicy &coalescing_policy() const { return mManager.coalescing_policy(); }
+
+    using ContinuousEdit = StaticDataManager::ContinuousEdit;
+
+    /**
+     * @brief Starts a continuous edit: until it ends, successive changes of the same element are merged
+     * into a single undo/redo entry. Callbacks are still called on every change.
+     */
+    void begin_continuous_edit() { mManager.begin_continuous_edit(); }
+
+    void end_continuous_edit() { mManager.end_continuous_edit(); }
+
+    /**
+     * @brief Starts a continuous edit ended at the end of the returned scope
+     */
+    [[nodiscard]] ContinuousEdit continuous_edit() { return mManager.continuous_edit(); }
+
     /**
      * @brief Undoes last change, calls all appropriate callbacks & dependencies
      * @return true if undo was done else false
@@ -154,10 +489,24 @@ namespace dmgmt
     template <typename El_t>
     bool isValidMemory(const El_t &element)
     {
-      return size_t(&element) >= size_t(&mData) && std::size_t(&element + 1) <= std::size_t(&mData + 1);
+      return size_t(&element) >= size_t(&mStored.data) && std::size_t(&element + 1) <= std::size_t(&mStored.data + 1);
+    }
+
+    /**
+     * @brief Check whether a computed value input is a computed value or belongs to the stored data structure
+     */
+    template <typename In_t>
+    bool isValidInput(const In_t &input)
+    {
+      if constexpr (is_computed_v<In_t>)
+        return input.valid();
+      else
+        return isValidMemory(input);
     }
 
-    Data_t mData;
+    ManagedData<Stored_t> mStored;
     StaticDataManager mManager;
+    std::size_t mWiredRevision = 0; // Revision of the run-time graph holding only the wiring
+    std::unique_ptr<StateCheckpoints> pCheckpoints; // Created by the first save_state()
   };
 } // namespace dmgmt
\ No newline at end of file
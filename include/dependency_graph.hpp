@@ -0,0 +1,333 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#pragma once
+
+#include <deque>
+#include <unordered_map>
+#include <vector>
+#include <cstddef>
+
+#include "containment_index.hpp"
+#include "flat_multimap.hpp"
+#include "poly_fun.hpp"
+#include "propagation_plan.hpp"
+#include "signature.hpp"
+
+namespace dmgmt
+{
+  /**
+   * @brief The callbacks & dependencies registered on elements, with the propagation plans compiled from them.
+   * Plans are compiled on first use and dropped when callbacks or dependencies are registered or removed.
+   *
+   * Callbacks & dependencies are indexed by FlatMultimap. The callables themselves live in a pool where they never move,
+   * plans point to them: a callable removed while a plan runs is destroyed once the outermost plan ends.
+   *
+   * With containment enabled, an element also implicitly depends on the closest element enclosing it
+   * in memory that has callbacks registered (a member on its structure), found through a ContainmentIndex.
+   * Elements sharing the same bytes (a structure & its only member) depend on each other.
+   *
+   * Hooks are callbacks the library registers for itself (e.g. the invalidation of computed values):
+   * they are called after the element's callbacks, and remove_callback(element) leaves them in place.
+   */
+  class DependencyGraph
+  {
+  private:
+    using callback_map_t = FlatMultimap<Signature, const PolyFun *>;
+    using dependency_map_t = FlatMultimap<Signature, Signature>;
+
+  public:
+    /// Handle of a registered callback, stays valid until the callback is removed
+    using callback_iter_t = callback_map_t::handle;
+    /// Handle of a registered dependency, stays valid until the dependency is removed
+    using dependency_iter_t = dependency_map_t::handle;
+
+    /// Handle of a registered hook, a distinct type so that it cannot be given to remove_callback()
+    struct hook_iter_t
+    {
+      callback_iter_t handle;
+    };
+
+    template <typename El_t, typename Functor_t>
+    callback_iter_t register_callback(const El_t &element, const Functor_t &functor)
+    {
+      return insert(mCallbacks, element, functor);
+    }
+
+    void remove_callback(const Signature &sig)
+    {
+      invalidate();
+      auto callbacks = mCallbacks.equal_range(sig);
+      for (auto start = callbacks.first; start != callbacks.second; ++start)
+        release(start->second);
+      if (mCallbacks.erase(sig) && mContainment && !mHooks.count(sig))
+        mContainers.erase(sig);
+    }
+
+    void remove_callback(const callback_iter_t &handle) { erase(mCallbacks, handle); }
+
+    /**
+     * @brief Registers a hook, a callback that only remove_hook() removes
+     * @return Handle of the hook, to be given to remove_hook()
+     */
+    template <typename El_t, typename Functor_t>
+    hook_iter_t register_hook(const El_t &element, const Functor_t &functor)
+    {
+      return {insert(mHooks, element, functor)};
+    }
+
+    void remove_hook(const hook_iter_t &hook) { erase(mHooks, hook.handle); }
+
+    /**
+     * @brief Number of callbacks, hooks & dependencies registered
+     */
+    std::size_t registrations() const { return mCallbacks.size() + mHooks.size() + mDependencies.size(); }
+
+    /**
+     * @brief Number of changes made to the registrations & to containment, e.g. to tell whether the graph changed
+     */
+    std::size_t revision() const { return mRevision; }
+
+    /**
+     * @brief Enables or disables containment dependencies: a change to an element then propagates
+     * to the callbacks of every registered element enclosing it, without registering these dependencies.
+     * Explicit dependencies still apply.
+     */
+    void set_containment(bool enabled)
+    {
+      if (enabled == mContainment)
+        return;
+      invalidate();
+      mContainment = enabled;
+      mContainers.clear();
+      if (mContainment)
+      {
+        mCallbacks.for_each_key([this](const Signature &sig) { mContainers.insert(sig); });
+        mHooks.for_each_key([this](const Signature &sig) {
+          if (!mCallbacks.count(sig))
+            mContainers.insert(sig);
+        });
+      }
+    }
+
+    bool containment() const { return mContainment; }
+
+    /**
+     * @brief Calls a function with every element that has callbacks, hooks or dependants, possibly several times
+     */
+    template <typename Function_t>
+    void for_each_element(const Function_t &function) const
+    {
+      mCallbacks.for_each_key(function);
+      mHooks.for_each_key(function);
+      mDependencies.for_each_key(function);
+    }
+
+    /**
+     * @return Handle of the registered dependency, or of the existing one if the pair was already registered
+     */
+    dependency_iter_t register_dependency(const Signature &source, const Signature &destination)
+    {
+      // First check whether the {source, destination} pair already exists
+      auto dependencies = mDependencies.equal_range(source);
+      for (auto start = dependencies.first; start != dependencies.second; ++start)
+        if (start->second == destination)
+          return mDependencies.handle_of(start);
+      // If not register this new dependency
+      invalidate();
+      return mDependencies.insert(source, destination);
+    }
+
+    void remove_dependency(const Signature &sig)
+    {
+      invalidate();
+      mDependencies.erase(sig);
+    }
+
+    void remove_dependency(const dependency_iter_t &handle)
+    {
+      invalidate();
+      mDependencies.erase(handle);
+    }
+
+    /**
+     * @brief Returns the compiled propagation plan of an element, nullptr if it is not compiled yet
+     */
+    const PropagationPlan *find_plan(const Signature &sig) const
+    {
+      auto found = mPlans.find(sig);
+      return found == mPlans.end() ? nullptr : &found->second;
+    }
+
+    /**
+     * @brief Returns the propagation plan of an element, compiling it on first use
+     */
+    const PropagationPlan &plan(const Signature &sig)
+    {
+      auto found = mPlans.find(sig);
+      if (found != mPlans.end())
+        return found->second;
+      PropagationPlan &plan = mPlans[sig];
+      mCompiler.compile(&sig, &sig + 1, Successors{this}, plan, mCallbacks, mHooks);
+      return plan;
+    }
+
+    /**
+     * @brief Compiles the propagation plan of several changed elements, it is not cached
+     */
+    template <typename Iterator_t>
+    void compile(Iterator_t first, Iterator_t last, PropagationPlan &plan)
+    {
+      mCompiler.compile(first, last, Successors{this}, plan, mCallbacks, mHooks);
+    }
+
+    const CompileStats &compile_stats() const { return mCompiler.stats(); }
+
+    /**
+     * @brief Calls the callbacks of a plan.
+     * Plans dropped by callbacks registering or removing callbacks or dependencies are kept alive until the plan ends.
+     */
+    void run(const PropagationPlan &plan)
+    {
+      ++mRunDepth;
+      for (const PropagationStep &step : plan)
+        step.callback->invoke(step.element);
+      if (--mRunDepth == 0)
+      {
+        mStalePlans.clear();
+        if (!mPins)
+          recycle_retired();
+      }
+    }
+
+    /**
+     * @brief Keeps the callbacks removed from now on alive until unpin(), as while a plan runs,
+     * for callers calling the steps of a plan outside run()
+     */
+    void pin() { ++mPins; }
+
+    void unpin()
+    {
+      if (--mPins == 0 && mRunDepth == 0)
+        recycle_retired();
+    }
+
+    /**
+     * @brief Calls alls callbacks linked to an element and its dependants.
+     * Each element reachable through the dependencies has its callbacks called once,
+     * after the elements it depends on.
+     */
+    void propagate(const Signature &sig) { run(plan(sig)); }
+
+  private:
+    template <typename El_t, typename Functor_t>
+    callback_iter_t insert(callback_map_t &map, const El_t &element, const Functor_t &functor)
+    {
+      invalidate();
+      if (mContainment && !mCallbacks.count(element) && !mHooks.count(element))
+        mContainers.insert(element);
+      return map.insert(element, acquire(PolyFun::fmt<El_t>(functor)));
+    }
+
+    void erase(callback_map_t &map, const callback_iter_t &handle)
+    {
+      auto callback = map.get(handle);
+      if (!callback)
+        return;
+      invalidate();
+      Signature sig = callback->first;
+      release(callback->second);
+      map.erase(handle);
+      if (mContainment && !mCallbacks.count(sig) && !mHooks.count(sig))
+        mContainers.erase(sig);
+    }
+
+    /**
+     * @brief Moves a callable into the pool
+     */
+    const PolyFun *acquire(PolyFun &&callback)
+    {
+      if (mFreeCallbacks.empty())
+        return &mCallbackPool.emplace_back(std::move(callback));
+      PolyFun *slot = mFreeCallbacks.back();
+      mFreeCallbacks.pop_back();
+      *slot = std::move(callback);
+      return slot;
+    }
+
+    /**
+     * @brief Gives a callable back to the pool, once no plan can be calling it
+     */
+    void release(const PolyFun *callback)
+    {
+      if (mRunDepth || mPins)
+        mRetiredCallbacks.push_back(const_cast<PolyFun *>(callback));
+      else
+        recycle(const_cast<PolyFun *>(callback));
+    }
+
+    void recycle(PolyFun *callback)
+    {
+      *callback = PolyFun{};
+      mFreeCallbacks.push_back(callback);
+    }
+
+    void recycle_retired()
+    {
+      for (PolyFun *callback : mRetiredCallbacks)
+        recycle(callback);
+      mRetiredCallbacks.clear();
+    }
+
+    /**
+     * @brief Lists the elements depending on an element, for the PlanCompiler
+     */
+    struct Successors
+    {
+      void operator()(const Signature &source, std::vector<Signature> &destinations) const
+      {
+        auto range = pGraph->mDependencies.equal_range(source);
+        for (auto start = range.first; start != range.second; ++start)
+          destinations.push_back(start->second);
+        if (pGraph->mContainment)
+          pGraph->mContainers.enclosing(source, [&](const Signature &container) { destinations.push_back(container); });
+      }
+
+      DependencyGraph *pGraph;
+    };
+
+    /**
+     * @brief Drops the compiled propagation plans
+     */
+    void invalidate()
+    {
+      ++mRevision;
+      if (mRunDepth && !mPlans.empty()) // Running plans are kept, nested propagations compile new ones
+        mStalePlans.push_back(std::move(mPlans));
+      mPlans.clear();
+    }
+
+    callback_map_t mCallbacks;
+    callback_map_t mHooks; // Registered by the library, called after the callbacks of their element
+    std::deque<PolyFun> mCallbackPool; // Never moves its elements
+    std::vector<PolyFun *> mFreeCallbacks;
+    std::vector<PolyFun *> mRetiredCallbacks; // Removed while a plan runs or the graph is pinned
+    dependency_map_t mDependencies; // Source key, destination mapped
+    ContainmentIndex mContainers;   // Elements with callbacks, when containment is enabled
+    bool mContainment = false;
+    std::size_t mRevision = 0;
+
+    std::unordered_map<Signature, PropagationPlan> mPlans; // Changed element key
+    PlanCompiler mCompiler;
+    std::size_t mRunDepth = 0;
+    std::size_t mPins = 0;
+    std::vector<std::unordered_map<Signature, PropagationPlan>> mStalePlans; // Dropped while plans run, kept in place
+  };
+} // namespace dmgmt
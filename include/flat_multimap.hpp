@@ -0,0 +1,380 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace dmgmt
+{
+  /**
+   * @brief A multimap with flat, open-addressing storage.
+   *
+   * The values of a key are stored as one contiguous run of a single value vector, in insertion order.
+   * Keys are found through a linear probing table of {key, run} slots, erased without tombstones.
+   * A run has a capacity, as a vector: inserting into a full run that is not at the end of the vector
+   * moves the run to the end with twice its size as capacity, so that interleaved insertions take amortized
+   * constant time. The space a moved run leaves is reclaimed once holes make up half of the vector.
+   *
+   * Values move when inserting or erasing: they are designated by handles, which stay valid
+   * until the value they designate is erased.
+   *
+   * @tparam Value_t Must be default constructible & copyable
+   */
+  template <typename Key_t, typename Value_t, typename Hash_t = std::hash<Key_t>>
+  class FlatMultimap
+  {
+  public:
+    struct value_type
+    {
+      Key_t first;
+      Value_t second;
+    };
+
+    using iterator = value_type *;
+    using const_iterator = const value_type *;
+
+    /**
+     * @brief Designates an inserted value. A handle to an erased value is detected as stale.
+     */
+    class handle
+    {
+    public:
+      handle() noexcept = default;
+
+      bool operator==(const handle &other) const noexcept { return mId == other.mId && mGeneration == other.mGeneration; }
+      bool operator!=(const handle &other) const noexcept { return !(*this == other); }
+
+    private:
+      friend class FlatMultimap;
+
+      handle(std::uint32_t id, std::uint32_t generation) noexcept : mId{id}, mGeneration{generation} {}
+
+      std::uint32_t mId = npos;
+      std::uint32_t mGeneration = 0;
+    };
+
+    FlatMultimap() : mSlots(min_slots) {}
+
+    std::size_t size() const { return mSize; }
+    bool empty() const { return size() == 0; }
+
+    /**
+     * @brief Number of values of a key
+     */
+    std::size_t count(const Key_t &key) const
+    {
+      std::size_t index = find_slot(key);
+      return index == npos ? 0 : mSlots[index].size;
+    }
+
+    std::pair<iterator, iterator> equal_range(const Key_t &key)
+    {
+      std::size_t index = find_slot(key);
+      if (index == npos)
+        return {nullptr, nullptr};
+      iterator first = mValues.data() + mSlots[index].begin;
+      return {first, first + mSlots[index].size};
+    }
+
+    std::pair<const_iterator, const_iterator> equal_range(const Key_t &key) const
+    {
+      return const_cast<FlatMultimap *>(this)->equal_range(key);
+    }
+
+    /**
+     * @brief Appends a value to the run of a key
+     */
+    handle insert(const Key_t &key, const Value_t &value)
+    {
+      std::size_t index = find_slot(key);
+      if (index == npos)
+      {
+        if ((mKeys + 1) * 4 > mSlots.size() * 3)
+          rehash(mSlots.size() * 2);
+        index = mask(mHash(key));
+        while (mSlots[index].size)
+          index = mask(index + 1);
+        mSlots[index] = {key, std::uint32_t(mValues.size()), 0, 0};
+        ++mKeys;
+      }
+
+      Slot &slot = mSlots[index];
+      if (slot.size == slot.capacity)
+      {
+        if (slot.begin + slot.capacity == mValues.size()) // The run ends the vector: it grows in place
+        {
+          mValues.emplace_back();
+          mValueHandles.push_back(npos);
+          ++slot.capacity;
+        }
+        else
+          relocate(slot, 2 * slot.size);
+      }
+
+      std::uint32_t id;
+      if (mFreeHandles.empty())
+      {
+        id = std::uint32_t(mHandles.size());
+        mHandles.push_back({npos, 0});
+      }
+      else
+      {
+        id = mFreeHandles.back();
+        mFreeHandles.pop_back();
+      }
+      std::uint32_t position = slot.begin + slot.size;
+      mHandles[id].position = position;
+      mValues[position] = {key, value};
+      mValueHandles[position] = id;
+      ++slot.size;
+      ++mSize;
+      shrink();
+      return {id, mHandles[id].generation};
+    }
+
+    /**
+     * @brief Returns the value designated by a handle, nullptr if it was erased
+     */
+    const value_type *get(const handle &h) const
+    {
+      if (h.mId >= mHandles.size() || mHandles[h.mId].generation != h.mGeneration || mHandles[h.mId].position == npos)
+        return nullptr;
+      return &mValues[mHandles[h.mId].position];
+    }
+
+    /**
+     * @brief Returns the handle of a value found through equal_range
+     */
+    handle handle_of(const_iterator it) const
+    {
+      std::uint32_t id = mValueHandles[std::size_t(it - mValues.data())];
+      return {id, mHandles[id].generation};
+    }
+
+    /**
+     * @brief Erases all values of a key
+     * @return Number of values erased
+     */
+    std::size_t erase(const Key_t &key)
+    {
+      std::size_t index = find_slot(key);
+      if (index == npos)
+        return 0;
+      std::size_t erased = mSlots[index].size;
+      for (std::uint32_t i = mSlots[index].begin; i < mSlots[index].begin + erased; ++i)
+      {
+        release(mValueHandles[i]);
+        mValueHandles[i] = npos;
+        mValues[i] = value_type{};
+      }
+      mSize -= erased;
+      mHoles += mSlots[index].capacity;
+      erase_slot(index);
+      shrink();
+      return erased;
+    }
+
+    /**
+     * @brief Erases the value designated by a handle, the order of the other values of its key is kept
+     * @return false if the handle is stale
+     */
+    bool erase(const handle &h)
+    {
+      const value_type *value = get(h);
+      if (!value)
+        return false;
+      std::size_t index = find_slot(value->first);
+      Slot &slot = mSlots[index];
+      std::uint32_t last = slot.begin + slot.size - 1;
+      for (std::uint32_t i = mHandles[h.mId].position; i < last; ++i)
+      {
+        mValues[i] = mValues[i + 1];
+        mValueHandles[i] = mValueHandles[i + 1];
+        mHandles[mValueHandles[i]].position = i;
+      }
+      release(h.mId);
+      mValueHandles[last] = npos;
+      mValues[last] = value_type{};
+      --mSize;
+      if (--slot.size == 0)
+      {
+        mHoles += slot.capacity;
+        erase_slot(index);
+      }
+      shrink();
+      return true;
+    }
+
+    /**
+     * @brief Calls f with each key once
+     */
+    template <typename F>
+    void for_each_key(F &&f) const
+    {
+      for (const Slot &slot : mSlots)
+        if (slot.size)
+          f(slot.key);
+    }
+
+    void clear()
+    {
+      mSlots.assign(min_slots, Slot{});
+      mValues.clear();
+      mValueHandles.clear();
+      for (std::uint32_t id = 0; id < mHandles.size(); ++id)
+        if (mHandles[id].position != npos)
+          release(id);
+      mKeys = 0;
+      mSize = 0;
+      mHoles = 0;
+    }
+
+  private:
+    static constexpr std::uint32_t npos = ~std::uint32_t(0);
+    static constexpr std::size_t min_slots = 16;
+
+    struct Slot
+    {
+      Key_t key;
+      std::uint32_t begin;
+      std::uint32_t size; // 0 for an empty slot
+      std::uint32_t capacity;
+    };
+
+    struct HandleRecord
+    {
+      std::uint32_t position; // Index in mValues, npos once erased
+      std::uint32_t generation;
+    };
+
+    std::size_t mask(std::size_t index) const { return index & (mSlots.size() - 1); }
+
+    std::size_t find_slot(const Key_t &key) const
+    {
+      for (std::size_t index = mask(mHash(key));; index = mask(index + 1))
+      {
+        const Slot &slot = mSlots[index];
+        if (!slot.size)
+          return npos;
+        if (slot.key == key)
+          return index;
+      }
+    }
+
+    /**
+     * @brief Empties a slot, shifting back the following slots of its probe sequence
+     */
+    void erase_slot(std::size_t index)
+    {
+      for (std::size_t next = mask(index + 1); mSlots[next].size; next = mask(next + 1))
+      {
+        std::size_t ideal = mask(mHash(mSlots[next].key));
+        // The slot can move to index if index is between its ideal position & its current position
+        if (mask(next - ideal) >= mask(next - index))
+        {
+          mSlots[index] = mSlots[next];
+          index = next;
+        }
+      }
+      mSlots[index] = Slot{};
+      --mKeys;
+    }
+
+    void release(std::uint32_t id)
+    {
+      mHandles[id].position = npos;
+      ++mHandles[id].generation;
+      mFreeHandles.push_back(id);
+    }
+
+    void rehash(std::size_t slots)
+    {
+      std::vector<Slot> old(slots);
+      old.swap(mSlots);
+      for (const Slot &slot : old)
+        if (slot.size)
+        {
+          std::size_t index = mask(mHash(slot.key));
+          while (mSlots[index].size)
+            index = mask(index + 1);
+          mSlots[index] = slot;
+        }
+    }
+
+    /**
+     * @brief Moves a run to the end of the value vector, the space it leaves becomes a hole
+     */
+    void relocate(Slot &slot, std::uint32_t capacity)
+    {
+      std::uint32_t begin = std::uint32_t(mValues.size());
+      mValues.resize(begin + capacity);
+      mValueHandles.resize(begin + capacity, npos);
+      for (std::uint32_t i = 0; i < slot.size; ++i)
+      {
+        mValues[begin + i] = std::move(mValues[slot.begin + i]);
+        mValueHandles[begin + i] = mValueHandles[slot.begin + i];
+        mHandles[mValueHandles[begin + i]].position = begin + i;
+        mValues[slot.begin + i] = value_type{};
+        mValueHandles[slot.begin + i] = npos;
+      }
+      mHoles += slot.capacity;
+      slot.begin = begin;
+      slot.capacity = capacity;
+    }
+
+    /**
+     * @brief Packs the runs once holes make up half of the value vector.
+     * Runs keep their spare capacity, up to their size.
+     */
+    void shrink()
+    {
+      if (mHoles * 2 < mValues.size())
+        return;
+      std::vector<value_type> values;
+      std::vector<std::uint32_t> valueHandles;
+      values.reserve(mValues.size() - mHoles);
+      valueHandles.reserve(mValues.size() - mHoles);
+      for (Slot &slot : mSlots)
+        if (slot.size)
+        {
+          std::uint32_t begin = std::uint32_t(values.size());
+          for (std::uint32_t i = slot.begin; i < slot.begin + slot.size; ++i)
+          {
+            mHandles[mValueHandles[i]].position = std::uint32_t(values.size());
+            values.push_back(std::move(mValues[i]));
+            valueHandles.push_back(mValueHandles[i]);
+          }
+          slot.begin = begin;
+          slot.capacity = std::min(slot.capacity, 2 * slot.size);
+          values.resize(begin + slot.capacity);
+          valueHandles.resize(begin + slot.capacity, npos);
+        }
+      mValues.swap(values);
+      mValueHandles.swap(valueHandles);
+      mHoles = 0;
+    }
+
+    std::vector<Slot> mSlots;
+    std::vector<value_type> mValues;
+    std::vector<std::uint32_t> mValueHandles; // Handle id of each value, npos for a hole
+    std::vector<HandleRecord> mHandles;       // Handle id key
+    std::vector<std::uint32_t> mFreeHandles;
+    std::size_t mKeys = 0;
+    std::size_t mSize = 0;
+    std::size_t mHoles = 0; // Values outside of the runs' capacity
+    Hash_t mHash;
+  };
+} // namespace dmgmt
@@ -0,0 +1,903 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "snapshot.hpp"
+#include "signature.hpp"
+#include "undo_journal.hpp"
+
+namespace dmgmt
+{
+  /**
+   * @brief A memory resource that hands out memory from big chunks obtained from an upstream resource.
+   * Memory is only given back in bulk: everything allocated after a mark (rewind)
+   * or every chunk filled before a mark (release_before).
+   * Individual deallocations are no-ops.
+   */
+  class HistoryArena : public std::pmr::memory_resource
+  {
+  public:
+    /**
+     * @brief A position in the arena
+     */
+    struct Mark
+    {
+      std::size_t chunk;
+      std::size_t offset;
+      std::size_t allocated; // Value of allocated() at the mark
+    };
+
+    explicit HistoryArena(std::pmr::memory_resource *upstream = std::pmr::get_default_resource(),
+                          std::size_t chunk_size = 64 * 1024)
+        : mChunks(upstream),
+          pUpstream{upstream},
+          mChunkSize{chunk_size}
+    {
+    }
+
+    HistoryArena(const HistoryArena &) = delete;
+    HistoryArena &operator=(const HistoryArena &) = delete;
+
+    ~HistoryArena() override
+    {
+      release();
+      drop_spare();
+    }
+
+    std::pmr::memory_resource *upstream() const { return pUpstream; }
+
+    /**
+     * @brief Returns the current position of the arena
+     */
+    Mark mark() const
+    {
+      if (mChunks.empty())
+        return {mFront, 0, mAllocated};
+      return {mFront + mChunks.size() - 1, mChunks.back().used, mAllocated};
+    }
+
+    /**
+     * @brief Releases everything that was allocated after a mark
+     */
+    void rewind(Mark mark)
+    {
+      while (!mChunks.empty() && mFront + mChunks.size() - 1 > mark.chunk)
+        pop_back_chunk();
+      if (!mChunks.empty() && mFront + mChunks.size() - 1 == mark.chunk)
+        mChunks.back().used = mark.offset;
+      mAllocated = mark.allocated;
+    }
+
+    /**
+     * @brief Releases the chunks that were entirely filled before a mark
+     */
+    void release_before(Mark mark)
+    {
+      while (!mChunks.empty() && mFront < mark.chunk)
+      {
+        free_chunk(mChunks.front());
+        mChunks.pop_front();
+        ++mFront;
+      }
+    }
+
+    /**
+     * @brief Releases everything allocated from the arena
+     */
+    void release()
+    {
+      while (!mChunks.empty())
+        pop_back_chunk();
+    }
+
+    /**
+     * @brief Number of bytes currently obtained from the upstream resource
+     */
+    std::size_t capacity() const { return mCapacity; }
+
+    /**
+     * @brief Running count of the bytes handed out, alignment padding included.
+     * Rewinding the arena sets it back to its value at the mark, so the difference
+     * between two marks is the memory used by what was allocated in between.
+     */
+    std::size_t allocated() const { return mAllocated; }
+
+    /**
+     * @brief Bytes handed out since the arena was created, alignment padding included. Never decreases.
+     */
+    std::uint64_t total_allocated() const { return mTotal; }
+
+  private:
+    struct Chunk
+    {
+      std::byte *data;
+      std::size_t size;
+      std::size_t used;
+    };
+
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+      if (!mChunks.empty())
+      {
+        Chunk &chunk = mChunks.back();
+        std::size_t start = align_up(chunk.used, alignment);
+        if (start + bytes <= chunk.size)
+        {
+          mAllocated += start + bytes - chunk.used;
+          mTotal += start + bytes - chunk.used;
+          chunk.used = start + bytes;
+          return chunk.data + start;
+        }
+      }
+      Chunk &chunk = push_chunk(bytes + alignment);
+      std::size_t start = align_up(chunk.used, alignment);
+      chunk.used = start + bytes;
+      mAllocated += chunk.used;
+      mTotal += chunk.used;
+      return chunk.data + start;
+    }
+
+    void do_deallocate(void *, std::size_t, std::size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+      return this == &other;
+    }
+
+    static std::size_t align_up(std::size_t offset, std::size_t alignment)
+    {
+      return (offset + alignment - 1) & ~(alignment - 1);
+    }
+
+    Chunk &push_chunk(std::size_t min_size)
+    {
+      if (mSpare.data && mSpare.size >= min_size)
+      {
+        mChunks.push_back(mSpare);
+        mSpare = {};
+      }
+      else
+      {
+        std::size_t size = min_size > mChunkSize ? min_size : mChunkSize;
+        auto data = static_cast<std::byte *>(pUpstream->allocate(size, alignof(std::max_align_t)));
+        mChunks.push_back({data, size, 0});
+        mCapacity += size;
+      }
+      mChunks.back().used = 0;
+      return mChunks.back();
+    }
+
+    /**
+     * @brief Frees the last chunk, keeping one regular sized chunk aside
+     * so that alternating undo and set calls do not hit the upstream resource.
+     */
+    void pop_back_chunk()
+    {
+      Chunk chunk = mChunks.back();
+      mChunks.pop_back();
+      if (!mSpare.data && chunk.size == mChunkSize)
+        mSpare = chunk;
+      else
+        free_chunk(chunk);
+    }
+
+    void free_chunk(const Chunk &chunk)
+    {
+      pUpstream->deallocate(chunk.data, chunk.size, alignof(std::max_align_t));
+      mCapacity -= chunk.size;
+    }
+
+    void drop_spare()
+    {
+      if (mSpare.data)
+        free_chunk(mSpare);
+      mSpare = {};
+    }
+
+    std::pmr::deque<Chunk> mChunks;
+    Chunk mSpare{};
+    std::size_t mFront = 0; // Index of the first chunk since the creation of the arena
+    std::pmr::memory_resource *pUpstream;
+    std::size_t mChunkSize;
+    std::size_t mCapacity = 0;
+    std::size_t mAllocated = 0;
+    std::uint64_t mTotal = 0;
+  };
+
+  /**
+   * @brief A memory resource that forwards to an upstream resource and counts the bytes currently allocated from it
+   */
+  class CountingResource : public std::pmr::memory_resource
+  {
+  public:
+    explicit CountingResource(std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+        : pUpstream{upstream}
+    {
+    }
+
+    /**
+     * @brief Bytes currently allocated
+     */
+    std::size_t allocated() const { return mAllocated; }
+
+    /**
+     * @brief Bytes allocated since the resource was created. Never decreases.
+     */
+    std::uint64_t total_allocated() const { return mTotal; }
+
+  private:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+      void *memory = pUpstream->allocate(bytes, alignment);
+      mAllocated += bytes;
+      mTotal += bytes;
+      return memory;
+    }
+
+    void do_deallocate(void *memory, std::size_t bytes, std::size_t alignment) override
+    {
+      pUpstream->deallocate(memory, bytes, alignment);
+      mAllocated -= bytes;
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+      return this == &other;
+    }
+
+    std::pmr::memory_resource *pUpstream;
+    std::size_t mAllocated = 0;
+    std::uint64_t mTotal = 0;
+  };
+
+  /**
+   * @brief Memory used by an undo/redo history
+   */
+  struct HistoryUsage
+  {
+    std::size_t undo_entries;
+    std::size_t undo_bytes; // Includes the images kept for the entry accepting changes
+    std::size_t redo_entries;
+    std::size_t redo_bytes;
+    std::size_t reserved_bytes; // Bytes obtained from the upstream memory resource
+    std::size_t journal_entries; // Entries spilled to the undo journal, undoable & redoable
+    std::size_t journal_bytes;   // Bytes used by these entries in the journal file
+  };
+
+  /**
+   * @brief An undo/redo history: a timeline of entries and a cursor.
+   * Entries before the cursor can be undone, entries after it can be redone.
+   * Entries and their snapshots are allocated from a HistoryArena, in timeline order,
+   * which makes dropping the redo branch or trimming the oldest entries a bulk release.
+   *
+   * The history can be bounded by a number of entries and a number of bytes,
+   * the oldest entries being evicted when a new entry is opened.
+   *
+   * With an UndoJournal, the evicted entries are spilled to the journal file instead of being dropped,
+   * the history then undoes & redoes them from the journal once it runs out of entries in memory.
+   *
+   * With a compression depth, snapshots of big trivially copyable elements are allocated apart from the arena
+   * and compressed once their entry is more than that many undo steps behind the cursor,
+   * they are decompressed straight into their element when the entry is undone or redone.
+   *
+   * With SnapshotEncoding::Delta, elements that are delta encodable are kept as full images in a scratch buffer
+   * while their entry accepts changes, then stored as the byte ranges that changed when the entry is closed
+   * (when a new entry is pushed or on undo).
+   */
+  class History
+  {
+  public:
+    /**
+     * @brief A group of changes that are undone & redone together
+     */
+    struct Entry
+    {
+      Entry(HistoryArena &arena, HistoryArena::Mark arena_mark)
+          : before{&arena},
+            after{&arena},
+            mark{arena_mark}
+      {
+        before.reserve(1);
+        after.reserve(1);
+      }
+
+      SnapshotGroup before;       // Element values before the changes
+      SnapshotGroup after;        // Element values after the changes
+      HistoryArena::Mark mark;    // Arena position at the creation of the entry
+      std::size_t blob_bytes = 0; // Bytes of the snapshot values allocated apart from the arena
+      bool cold = false;          // Whether the snapshot values were compressed
+    };
+
+    /// Compression depth turning compression off
+    static constexpr std::size_t uncompressed = std::numeric_limits<std::size_t>::max();
+
+    explicit History(std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+        : mArena{upstream},
+          mBlobs{upstream},
+          mEntries(upstream),
+          mPending(upstream),
+          mScratch(upstream),
+          mRanges(upstream),
+          mSignatures(upstream),
+          mOrder(upstream),
+          mOverlaps(upstream),
+          mImage(upstream),
+          mCompressed(upstream)
+    {
+    }
+
+    History(const History &) = delete;
+    History &operator=(const History &) = delete;
+
+    ~History() { clear(); }
+
+    std::size_t undo_size() const { return mCursor + (pJournal ? pJournal->undo_size() : 0); }
+    std::size_t redo_size() const { return mEntries.size() - mCursor + (pJournal ? pJournal->redo_size() : 0); }
+
+    /**
+     * @brief Bounds the history. Limits are enforced when an entry is opened, by evicting the oldest entries,
+     * the entry being opened is always kept.
+     * Bytes are counted from the history arena and the snapshots allocated apart from it for compression:
+     * snapshot values owning other memory (e.g. std::string) only account for their own size.
+     * @param max_entries Maximum number of entries
+     * @param max_bytes Maximum number of bytes used by the entries
+     */
+    void set_limits(std::size_t max_entries, std::size_t max_bytes)
+    {
+      mMaxEntries = max_entries;
+      mMaxBytes = max_bytes;
+    }
+
+    /**
+     * @brief Spills the entries evicted by the limits to a journal instead of dropping them.
+     * Entries that cannot be journaled (a value with no serializer) are dropped along with every older entry.
+     * @param journal Journal to spill to, nullptr to drop evicted entries again. Entries in the previous journal are lost.
+     */
+    void set_journal(std::unique_ptr<UndoJournal> journal)
+    {
+      pJournal = std::move(journal);
+      if (pJournal)
+        pJournal->clear();
+    }
+
+    UndoJournal *journal() const { return pJournal.get(); }
+
+    /**
+     * @brief Compresses the snapshots of the entries that are more than a number of undo steps behind the cursor.
+     * Only the snapshots of elements that are is_compressible_v and that are recorded while compression is on get compressed:
+     * they are allocated apart from the arena, which could not give back the memory of a single snapshot.
+     * Compressed snapshots are decompressed straight into their element by undo & redo,
+     * and for good if their entry accepts changes again.
+     * @param depth Number of most recent undoable entries kept uncompressed, at least 1. History::uncompressed turns compression off.
+     */
+    void set_compression_depth(std::size_t depth)
+    {
+      mCompressionDepth = std::max<std::size_t>(depth, 1);
+      compress_cold();
+    }
+
+    std::size_t compression_depth() const { return mCompressionDepth; }
+
+    HistoryUsage usage() const
+    {
+      std::size_t first = mEntries.empty() ? mArena.allocated() : mEntries.front()->mark.allocated;
+      std::size_t cursor = mCursor == mEntries.size() ? mArena.allocated() : mEntries[mCursor]->mark.allocated;
+      std::size_t undo_blobs = 0;
+      std::size_t redo_blobs = 0;
+      if (mBlobs.allocated())
+        for (std::size_t i = 0; i < mEntries.size(); ++i)
+          (i < mCursor ? undo_blobs : redo_blobs) += mEntries[i]->blob_bytes;
+      return {mCursor, cursor - first + mScratch.size() + undo_blobs,
+              mEntries.size() - mCursor, mArena.allocated() - cursor + redo_blobs,
+              mArena.capacity() + mBlobs.allocated(),
+              pJournal ? pJournal->undo_size() + pJournal->redo_size() : 0,
+              pJournal ? pJournal->size_bytes() : 0};
+    }
+
+    /**
+     * @brief Bytes recorded into the history since it was created, entries & snapshots included. Never decreases.
+     * Delta encoded snapshots are counted when their entry is closed.
+     */
+    std::uint64_t recorded_bytes() const { return mArena.total_allocated() + mBlobs.total_allocated(); }
+
+    SnapshotEncoding encoding() const { return mEncoding; }
+
+    /**
+     * @brief Sets how the values of elements changed from now on are stored
+     */
+    void set_encoding(SnapshotEncoding encoding) { mEncoding = encoding; }
+
+    /**
+     * @brief Records the value of an element before it is changed
+     * @param entry Entry returned by push or last
+     */
+    template <typename El_t>
+    void record_before(Entry &entry, El_t &element)
+    {
+      assert(&entry == pOpen);
+      if constexpr (is_delta_encodable_v<El_t>)
+        if (mEncoding == SnapshotEncoding::Delta)
+          return record_delta(entry, element);
+      std::size_t blobs = mBlobs.allocated();
+      entry.before.add_once(element, snapshot_resource<El_t>());
+      entry.blob_bytes += mBlobs.allocated() - blobs;
+    }
+
+    /**
+     * @brief Records the value of an element after it was changed
+     * @param entry Entry returned by push or last
+     */
+    template <typename El_t>
+    void record_after(Entry &entry, El_t &element)
+    {
+      if constexpr (is_delta_encodable_v<El_t>)
+        if (find_pending(element))
+          return;
+      std::size_t blobs = mBlobs.allocated();
+      entry.after.add_latest(element, snapshot_resource<El_t>());
+      entry.blob_bytes += mBlobs.allocated() - blobs;
+    }
+
+    /**
+     * @brief Records a change in one step, from a copy of the element value before the change.
+     * Stored as full snapshots whatever the encoding.
+     * @param entry Entry returned by push or last
+     * @param before Value of the element before the change, moved into the entry if it is an rvalue
+     * @param element Element after the change
+     */
+    template <typename El_t, typename Before_t>
+    void record(Entry &entry, Before_t &&before, El_t &element)
+    {
+      assert(&entry == pOpen);
+      std::pmr::memory_resource *resource = snapshot_resource<El_t>();
+      std::size_t blobs = mBlobs.allocated();
+      if (!entry.before.find(element))
+        entry.before.add(Snapshot::adopt(SnapshotData<El_t>::create(resource, std::forward<Before_t>(before), &element), resource));
+      entry.after.add_latest(element, resource);
+      entry.blob_bytes += mBlobs.allocated() - blobs;
+    }
+
+    /**
+     * @brief Records a change that moves a new value into an element, without copying either value:
+     * the previous value is moved into the entry, unless the entry already holds one,
+     * and the new value is only copied when the entry is undone.
+     * With a journal, spilled entries need their values: the new value is then copied right away.
+     * @param entry Entry returned by push or last
+     * @param element Element to change
+     * @param value New value of the element
+     */
+    template <typename El_t>
+    void record_move(Entry &entry, El_t &element, El_t &&value)
+    {
+      assert(&entry == pOpen);
+      if (!entry.before.find(element))
+        entry.before.add(Snapshot::adopt(SnapshotData<El_t>::create(&mArena, std::move(element), &element), &mArena));
+      element = std::move(value);
+      if (pJournal)
+        return entry.after.add_latest(element);
+      entry.after.erase(element);
+      entry.after.add(Snapshot::adopt(DeferredSnapshotData<El_t>::create(&mArena, element), &mArena));
+    }
+
+    /**
+     * @brief Drops the redo branch then opens a new entry at the end of the timeline
+     */
+    Entry &push()
+    {
+      close();
+      clear_redos();
+      evict();
+      HistoryArena::Mark mark = mArena.mark();
+      void *storage = mArena.allocate(sizeof(Entry), alignof(Entry));
+      mEntries.push_back(new (storage) Entry{mArena, mark});
+      mCursor = mEntries.size();
+      pOpen = mEntries.back();
+      compress_cold();
+      return *pOpen;
+    }
+
+    /**
+     * @brief Drops the redo branch then returns the last undoable entry, opening one if there is none
+     */
+    Entry &last()
+    {
+      clear_redos();
+      if (mEntries.empty())
+        return push();
+      if (pOpen != mEntries.back())
+        reopen(*mEntries.back());
+      return *pOpen;
+    }
+
+    /**
+     * @brief Rolls back the last undoable entry
+     * @param callback Function called with the Signature of every restored element
+     * @return true if an entry was undone
+     */
+    bool undo(std::function<void(const Signature &)> callback = nullptr)
+    {
+      if (mCursor == 0)
+        return pJournal && pJournal->undo(callback);
+      close();
+      Entry &entry = *mEntries[--mCursor];
+      entry.after.hold();
+      entry.before.rollback(callback);
+      return true;
+    }
+
+    /**
+     * @brief Restores the first redoable entry
+     * @param callback Function called with the Signature of every restored element
+     * @return true if an entry was redone
+     */
+    bool redo(std::function<void(const Signature &)> callback = nullptr)
+    {
+      if (pJournal && pJournal->redo(callback))
+        return true;
+      if (mCursor == mEntries.size())
+        return false;
+      mEntries[mCursor++]->after.restore(callback);
+      return true;
+    }
+
+    /**
+     * @brief Calls a function with the Signature of every element the next undo() writes
+     */
+    void visit_undo(const std::function<void(const Signature &)> &visitor)
+    {
+      if (mCursor == 0)
+      {
+        if (pJournal)
+          pJournal->visit_undo(visitor);
+        return;
+      }
+      SnapshotGroup &before = mEntries[mCursor - 1]->before;
+      for (std::size_t i = 0; i < before.size(); ++i)
+        if (before[i].valid())
+          visitor(before[i].signature());
+      if (pOpen == mEntries[mCursor - 1])
+        for (const PendingDelta &pending : mPending)
+          visitor(pending.sig);
+    }
+
+    /**
+     * @brief Calls a function with the Signature of every element the next redo() writes
+     */
+    void visit_redo(const std::function<void(const Signature &)> &visitor)
+    {
+      if (pJournal && pJournal->redo_size())
+        return pJournal->visit_redo(visitor);
+      if (mCursor == mEntries.size())
+        return;
+      SnapshotGroup &after = mEntries[mCursor]->after;
+      for (std::size_t i = 0; i < after.size(); ++i)
+        visitor(after[i].signature());
+    }
+
+    /**
+     * @brief Drops every redoable entry and releases their memory in one go
+     */
+    void clear_redos()
+    {
+      if (pJournal)
+        pJournal->clear_redos();
+      if (mCursor == mEntries.size())
+        return;
+      HistoryArena::Mark mark = mEntries[mCursor]->mark;
+      for (auto it = mEntries.begin() + mCursor; it != mEntries.end(); ++it)
+        (*it)->~Entry();
+      mEntries.erase(mEntries.begin() + mCursor, mEntries.end());
+      mArena.rewind(mark);
+    }
+
+    /**
+     * @brief Drops the oldest undoable entries and releases their memory.
+     * Entries spilled to the journal are older than any entry in memory, they are all dropped.
+     * @param count Number of entries in memory to drop
+     */
+    void trim(std::size_t count)
+    {
+      if (pJournal)
+        pJournal->clear();
+      drop(count);
+    }
+
+    /**
+     * @brief Drops the whole history
+     */
+    void clear()
+    {
+      pOpen = nullptr;
+      mPending.clear();
+      mScratch.clear();
+      for (Entry *entry : mEntries)
+        entry->~Entry();
+      mEntries.clear();
+      mCursor = 0;
+      mArena.release();
+      if (pJournal)
+        pJournal->clear();
+    }
+
+  private:
+    /**
+     * @brief Drops the oldest undoable entries in memory and releases their memory
+     */
+    void drop(std::size_t count)
+    {
+      if (count > mCursor)
+        count = mCursor;
+      if (count == 0)
+        return;
+      close();
+      for (auto it = mEntries.begin(); it != mEntries.begin() + count; ++it)
+        (*it)->~Entry();
+      mEntries.erase(mEntries.begin(), mEntries.begin() + count);
+      mCursor -= count;
+      if (mEntries.empty())
+        mArena.release();
+      else
+        mArena.release_before(mEntries.front()->mark);
+    }
+
+    /**
+     * @brief Evicts the oldest entries until there is room for a new entry, spilling them to the journal if any
+     */
+    void evict()
+    {
+      std::size_t count = 0;
+      std::size_t size = mEntries.size();
+      std::size_t blobs = mBlobs.allocated();
+      std::size_t bytes = mArena.allocated() - (size ? mEntries.front()->mark.allocated : 0) + blobs;
+      while (count < size && (size - count >= mMaxEntries || bytes > mMaxBytes))
+      {
+        blobs -= mEntries[count]->blob_bytes;
+        ++count;
+        bytes = mArena.allocated() - (count < size ? mEntries[count]->mark.allocated : mArena.allocated()) + blobs;
+      }
+      if (pJournal && count)
+      {
+        close();
+        for (std::size_t i = 0; i < count; ++i)
+          if (!pJournal->append(mEntries[i]->before, mEntries[i]->after))
+            pJournal->clear();
+      }
+      drop(count);
+    }
+
+    /**
+     * @brief Memory resource of the snapshots of an element: apart from the arena if they may be compressed
+     */
+    template <typename El_t>
+    std::pmr::memory_resource *snapshot_resource()
+    {
+      if constexpr (is_compressible_v<El_t>)
+        if (mCompressionDepth != uncompressed)
+          return &mBlobs;
+      return &mArena;
+    }
+
+    /**
+     * @brief Compresses the entries more than the compression depth behind the cursor,
+     * from the most recent one down to the first one that was already compressed
+     */
+    void compress_cold()
+    {
+      if (mCompressionDepth == uncompressed || mCursor <= mCompressionDepth)
+        return;
+      for (std::size_t i = mCursor - mCompressionDepth; i-- > 0 && !mEntries[i]->cold;)
+      {
+        Entry &entry = *mEntries[i];
+        std::size_t blobs = mBlobs.allocated();
+        for (SnapshotGroup *group : {&entry.before, &entry.after})
+          for (std::size_t j = 0; j < group->size(); ++j)
+            if ((*group)[j].resource() == &mBlobs)
+              (*group)[j].compress(mCompressed);
+        entry.blob_bytes += mBlobs.allocated() - blobs;
+        entry.cold = true;
+      }
+    }
+
+    /**
+     * @brief Replaces the compressed snapshots of an entry by full byte snapshots, which can capture new values
+     */
+    void inflate(Entry &entry)
+    {
+      for (SnapshotGroup *group : {&entry.before, &entry.after})
+        for (std::size_t i = 0; i < group->size(); ++i)
+        {
+          Snapshot &snapshot = (*group)[i];
+          if (!snapshot.is_compressed())
+            continue;
+          Signature sig = snapshot.signature();
+          mImage.resize(sig.size());
+          snapshot.overlay(mImage.data());
+          snapshot = Snapshot::adopt(DeltaSnapshotData::create_full(&mBlobs, sig, mImage.data()), &mBlobs);
+        }
+      entry.cold = false;
+    }
+
+    /**
+     * @brief A delta encodable element of the last entry, waiting for the entry to be closed
+     */
+    struct PendingDelta
+    {
+      Signature sig;
+      std::size_t slot;   // Index of the element snapshot in the entry before group
+      std::size_t offset; // Offset of the element image in the scratch buffer
+    };
+
+    const PendingDelta *find_pending(const Signature &sig) const
+    {
+      for (const PendingDelta &pending : mPending)
+        if (pending.sig == sig)
+          return &pending;
+      return nullptr;
+    }
+
+    /**
+     * @brief Keeps the image of an element before its first change in the entry
+     */
+    void record_delta(Entry &entry, const Signature &sig)
+    {
+      if (find_pending(sig) || entry.before.find(sig))
+        return;
+      mPending.push_back({sig, entry.before.size(), keep_image(sig)});
+      entry.before.add(Snapshot{});
+    }
+
+    /**
+     * @brief Copies the current image of an element to the scratch buffer
+     * @return Offset of the image in the scratch buffer
+     */
+    std::size_t keep_image(const Signature &sig)
+    {
+      std::size_t offset = mScratch.size();
+      mScratch.resize(offset + sig.size());
+      std::memcpy(mScratch.data() + offset, sig.address(), sig.size());
+      return offset;
+    }
+
+    /**
+     * @brief Makes a closed entry the one accepting changes.
+     * Elements are currently in the state the entry leads to,
+     * so each byte delta can be turned back into the image of its element before the entry.
+     */
+    void reopen(Entry &entry)
+    {
+      close();
+      std::size_t blobs = mBlobs.allocated();
+      if (entry.cold)
+        inflate(entry);
+      for (std::size_t i = 0; i < entry.before.size(); ++i)
+      {
+        Snapshot &snapshot = entry.before[i];
+        if (!snapshot.is_delta())
+          continue;
+        Signature sig = snapshot.signature();
+        std::size_t offset = keep_image(sig);
+        snapshot.overlay(mScratch.data() + offset);
+        snapshot = Snapshot{};
+        entry.after.erase(sig);
+        mPending.push_back({sig, i, offset});
+      }
+      entry.blob_bytes += mBlobs.allocated() - blobs;
+      pOpen = &entry;
+    }
+
+    /**
+     * @brief Stores the pending elements of the last entry as byte deltas.
+     * An element overlapping another element of the entry is stored whole,
+     * snapshot order then decides which value each byte gets back.
+     */
+    void close()
+    {
+      Entry *open = std::exchange(pOpen, nullptr);
+      if (mPending.empty())
+        return;
+      Entry &entry = *open;
+      std::pmr::memory_resource *resource = entry.before.resource();
+      find_overlaps(entry);
+
+      for (const PendingDelta &pending : mPending)
+      {
+        const std::byte *original = mScratch.data() + pending.offset;
+        Signature sig = pending.sig;
+        DeltaSnapshotData *before;
+        DeltaSnapshotData *after;
+        if (mOverlaps[pending.slot])
+        {
+          before = DeltaSnapshotData::create_full(resource, sig, original);
+          after = DeltaSnapshotData::create_full(resource, sig, sig.address());
+        }
+        else
+        {
+          mRanges.clear();
+          diff_ranges(original, static_cast<const std::byte *>(sig.address()), sig.size(), mRanges);
+          before = DeltaSnapshotData::create(resource, sig, mRanges, original);
+          after = DeltaSnapshotData::create(resource, sig, mRanges, sig.address());
+        }
+        entry.before[pending.slot] = Snapshot::adopt(before, resource);
+        entry.after.add(Snapshot::adopt(after, resource));
+      }
+      mPending.clear();
+      mScratch.clear();
+    }
+
+    /**
+     * @brief Flags, in mOverlaps, the elements of an entry that share bytes with another element of the entry
+     */
+    void find_overlaps(Entry &entry)
+    {
+      std::size_t count = entry.before.size();
+      mSignatures.resize(count);
+      mOrder.resize(count);
+      mOverlaps.assign(count, false);
+      for (std::size_t i = 0; i < count; ++i)
+      {
+        mSignatures[i] = entry.before[i].signature();
+        mOrder[i] = i;
+      }
+      for (const PendingDelta &pending : mPending)
+        mSignatures[pending.slot] = pending.sig;
+
+      auto start = [&](std::size_t i) { return static_cast<const std::byte *>(mSignatures[i].address()); };
+      std::sort(mOrder.begin(), mOrder.end(), [&](std::size_t l, std::size_t r) { return start(l) < start(r); });
+
+      const std::byte *furthest_end = nullptr;
+      std::size_t furthest = 0;
+      for (std::size_t i : mOrder)
+      {
+        if (furthest_end && start(i) < furthest_end)
+          mOverlaps[i] = mOverlaps[furthest] = true;
+        if (!furthest_end || start(i) + mSignatures[i].size() > furthest_end)
+        {
+          furthest_end = start(i) + mSignatures[i].size();
+          furthest = i;
+        }
+      }
+    }
+
+    HistoryArena mArena;
+    CountingResource mBlobs; // Snapshots that may be compressed
+    std::pmr::deque<Entry *> mEntries;
+    std::size_t mCursor = 0; // Number of undoable entries
+    Entry *pOpen = nullptr;  // Last entry, while it accepts changes
+    std::size_t mMaxEntries = std::numeric_limits<std::size_t>::max();
+    std::size_t mMaxBytes = std::numeric_limits<std::size_t>::max();
+    SnapshotEncoding mEncoding = SnapshotEncoding::Full;
+    std::size_t mCompressionDepth = uncompressed;
+    std::unique_ptr<UndoJournal> pJournal;
+
+    std::pmr::vector<PendingDelta> mPending;
+    std::pmr::vector<std::byte> mScratch;
+    std::pmr::vector<ByteRange> mRanges;
+    std::pmr::vector<Signature> mSignatures;
+    std::pmr::vector<std::size_t> mOrder;
+    std::pmr::vector<bool> mOverlaps;
+    std::pmr::vector<std::byte> mImage;
+    std::pmr::vector<std::byte> mCompressed;
+  };
+} // namespace dmgmt
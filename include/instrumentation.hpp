@@ -0,0 +1,251 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+
+#include "propagation_plan.hpp"
+#include "signature.hpp"
+
+namespace dmgmt
+{
+  /**
+   * @brief A latency histogram with power of two buckets: bucket i counts the durations of [2^i, 2^(i+1)) nanoseconds,
+   * bucket 0 also counts durations under a nanosecond
+   */
+  class LatencyHistogram
+  {
+  public:
+    static constexpr std::size_t bucket_count = 64;
+
+    void add(std::chrono::nanoseconds duration)
+    {
+      std::uint64_t ns = std::uint64_t(std::max<std::chrono::nanoseconds::rep>(duration.count(), 1));
+      std::size_t bucket = 0;
+      while (ns >>= 1)
+        ++bucket;
+      ++mBuckets[bucket];
+      ++mCount;
+      mTotal += std::uint64_t(duration.count());
+    }
+
+    std::uint64_t count() const { return mCount; }
+    std::uint64_t bucket(std::size_t index) const { return mBuckets[index]; }
+    std::chrono::nanoseconds mean() const { return std::chrono::nanoseconds{mCount ? mTotal / mCount : 0}; }
+
+    /**
+     * @brief Upper bound of the bucket holding the given quantile of the durations, e.g. quantile(0.99),
+     * 0 if no duration was added
+     */
+    std::chrono::nanoseconds quantile(double q) const
+    {
+      if (mCount == 0)
+        return std::chrono::nanoseconds{0};
+      std::uint64_t rank = std::uint64_t(q * double(mCount));
+      std::uint64_t seen = 0;
+      for (std::size_t i = 0; i < bucket_count; ++i)
+        if ((seen += mBuckets[i]) > rank || seen == mCount)
+          return std::chrono::nanoseconds{i + 1 < bucket_count ? (std::int64_t{1} << (i + 1)) - 1 : INT64_MAX};
+      return std::chrono::nanoseconds{0};
+    }
+
+  private:
+    std::array<std::uint64_t, bucket_count> mBuckets{};
+    std::uint64_t mCount = 0;
+    std::uint64_t mTotal = 0;
+  };
+
+  /**
+   * @brief Propagation counters of a manager
+   */
+  struct PropagationCounters
+  {
+    std::uint64_t propagations;  // Plans run
+    std::uint64_t callbacks;     // Callbacks called by these plans
+    std::uint64_t max_callbacks; // Most callbacks called by a single plan
+    std::uint64_t compilations;  // Plans compiled, propagating an element whose plan is cached searches nothing
+    std::uint64_t visited;       // Elements reached by the compilations
+    std::uint64_t max_visited;   // Most elements reached by a single compilation
+    std::uint64_t max_depth;     // Deepest dependency search of a compilation
+  };
+
+  /**
+   * @brief Operations timed by an Instrumentation
+   */
+  enum class InstrumentedOperation
+  {
+    Set, // set & call
+    Undo,
+    Redo
+  };
+
+#ifdef DMGMT_ENABLE_INSTRUMENTATION
+
+  /**
+   * @brief Hot path counters & latency histograms of a manager, enabled by defining DMGMT_ENABLE_INSTRUMENTATION.
+   * When it is not defined, Instrumentation records nothing & its queries return zeros.
+   */
+  class Instrumentation
+  {
+    using instrumentation_clock = std::chrono::steady_clock;
+
+  public:
+    static constexpr bool enabled = true;
+
+    /**
+     * @brief Times an operation, from its creation to its destruction, & counts the history bytes it recorded
+     */
+    class Probe
+    {
+    public:
+      Probe(Instrumentation &instrumentation, InstrumentedOperation operation, std::uint64_t recordedBytes)
+          : pInstrumentation{&instrumentation},
+            mOperation{operation},
+            mRecordedBytes{recordedBytes},
+            mStart{instrumentation_clock::now()}
+      {
+      }
+
+      Probe(const Probe &) = delete;
+      Probe &operator=(const Probe &) = delete;
+
+      ~Probe() { pInstrumentation->mLatencies[std::size_t(mOperation)].add(instrumentation_clock::now() - mStart); }
+
+      /**
+       * @param recordedBytes History::recorded_bytes() once the operation is recorded, before callbacks are called
+       */
+      void recorded(std::uint64_t recordedBytes) { pInstrumentation->mSnapshotBytes += recordedBytes - mRecordedBytes; }
+
+    private:
+      Instrumentation *pInstrumentation;
+      InstrumentedOperation mOperation;
+      std::uint64_t mRecordedBytes;
+      instrumentation_clock::time_point mStart;
+    };
+
+    Probe probe(InstrumentedOperation operation, std::uint64_t recordedBytes)
+    {
+      return Probe{*this, operation, recordedBytes};
+    }
+
+    void changed(const Signature &sig) { ++mChanges[sig]; }
+
+    void elided() { ++mElided; }
+
+    void propagated(std::size_t callbacks)
+    {
+      ++mPropagation.propagations;
+      mPropagation.callbacks += callbacks;
+      mPropagation.max_callbacks = std::max<std::uint64_t>(mPropagation.max_callbacks, callbacks);
+    }
+
+    void compiled(const CompileStats &stats)
+    {
+      ++mPropagation.compilations;
+      mPropagation.visited += stats.visited;
+      mPropagation.max_visited = std::max<std::uint64_t>(mPropagation.max_visited, stats.visited);
+      mPropagation.max_depth = std::max<std::uint64_t>(mPropagation.max_depth, stats.depth);
+    }
+
+    /**
+     * @brief Number of times an element was changed through set/call
+     */
+    std::uint64_t changes(const Signature &sig) const
+    {
+      auto found = mChanges.find(sig);
+      return found == mChanges.end() ? 0 : found->second;
+    }
+
+    /**
+     * @brief Change counts of all the elements changed through set/call
+     */
+    const std::unordered_map<Signature, std::uint64_t> &changes() const { return mChanges; }
+
+    /**
+     * @brief Number of set/call that left their element unchanged, which were neither recorded nor propagated
+     */
+    std::uint64_t elided_writes() const { return mElided; }
+
+    const PropagationCounters &propagation() const { return mPropagation; }
+
+    /**
+     * @brief Bytes recorded into the undo/redo history by set/call
+     */
+    std::uint64_t snapshot_bytes() const { return mSnapshotBytes; }
+
+    const LatencyHistogram &latency(InstrumentedOperation operation) const
+    {
+      return mLatencies[std::size_t(operation)];
+    }
+
+    void reset() { *this = Instrumentation{}; }
+
+  private:
+    std::unordered_map<Signature, std::uint64_t> mChanges;
+    std::uint64_t mElided = 0;
+    PropagationCounters mPropagation{0, 0, 0, 0, 0, 0, 0};
+    std::uint64_t mSnapshotBytes = 0;
+    std::array<LatencyHistogram, 3> mLatencies;
+  };
+
+#else
+
+  class Instrumentation
+  {
+  public:
+    static constexpr bool enabled = false;
+
+    class Probe
+    {
+    public:
+      void recorded(std::uint64_t) {}
+    };
+
+    Probe probe(InstrumentedOperation, std::uint64_t) { return {}; }
+    void changed(const Signature &) {}
+    void elided() {}
+    void propagated(std::size_t) {}
+    void compiled(const CompileStats &) {}
+
+    std::uint64_t changes(const Signature &) const { return 0; }
+
+    const std::unordered_map<Signature, std::uint64_t> &changes() const
+    {
+      static const std::unordered_map<Signature, std::uint64_t> none;
+      return none;
+    }
+
+    std::uint64_t elided_writes() const { return 0; }
+
+    const PropagationCounters &propagation() const
+    {
+      static const PropagationCounters none{0, 0, 0, 0, 0, 0, 0};
+      return none;
+    }
+
+    std::uint64_t snapshot_bytes() const { return 0; }
+
+    const LatencyHistogram &latency(InstrumentedOperation) const
+    {
+      static const LatencyHistogram none;
+      return none;
+    }
+
+    void reset() {}
+  };
+
+#endif
+} // namespace dmgmt
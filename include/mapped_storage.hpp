@@ -0,0 +1,262 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#pragma once
+
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <typeinfo>
+#include <cstddef>
+#include <cstdint>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace dmgmt
+{
+  /**
+   * @brief Checksum of a range of bytes, hashed a word at a time
+   */
+  inline std::uint64_t checksum_bytes(const std::byte *data, std::size_t size)
+  {
+    std::uint64_t h = 0x9E3779B97F4A7C15ull ^ size;
+    std::size_t i = 0;
+    for (std::uint64_t word; i + sizeof(word) <= size; i += sizeof(word))
+    {
+      std::memcpy(&word, data + i, sizeof(word));
+      h = (h ^ word) * 0xD6E8FEB86659FD93ull;
+      h ^= h >> 32;
+    }
+    for (; i < size; ++i)
+      h = (h ^ std::uint64_t(data[i])) * 0x100000001B3ull;
+    return h ^ (h >> 29);
+  }
+
+  /**
+   * @brief How the data of a MappedStorage was obtained when the file was opened
+   */
+  enum class StorageOrigin
+  {
+    Created,  // New or incompatible file, the data is value initialized
+    Restored, // The file was closed cleanly, the data is mapped as it was left
+    Recovered // The file was not closed cleanly, the data is the one of the last checkpoint
+  };
+
+  /**
+   * @brief Places a trivially copyable object in a memory mapped file, so that a restarted process
+   * maps the state left by the previous one instead of rebuilding it.
+   *
+   * The file holds a header page, the live object and two checkpoint slots.
+   * Changes to the live object reach the file as the kernel writes dirty pages back, flush() schedules it.
+   * checkpoint() copies the live object to the oldest slot and syncs it: if the process dies
+   * without closing the storage, the next one starts from the most recent intact checkpoint.
+   *
+   * A file written for another Data_t layout (size, alignment or type name) is discarded.
+   */
+  template <typename Data_t>
+  class MappedStorage
+  {
+  public:
+    /**
+     * @param path Path of the file, created if it does not exist
+     */
+    explicit MappedStorage(std::string path)
+        : mPath{std::move(path)},
+          mPage{std::size_t(::sysconf(_SC_PAGESIZE))},
+          mSlotSize{(sizeof(Data_t) + mPage - 1) / mPage * mPage},
+          mFileSize{mPage + 3 * mSlotSize}
+    {
+      static_assert(std::is_trivially_copyable_v<Data_t>, "MappedStorage requires a trivially copyable type");
+      mFile = ::open(mPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+      if (mFile < 0)
+        throw std::system_error(errno, std::generic_category(), "cannot open mapped storage " + mPath);
+      try
+      {
+        open();
+      }
+      catch (...)
+      {
+        if (pMap)
+          ::munmap(pMap, mFileSize);
+        ::close(mFile);
+        throw;
+      }
+    }
+
+    MappedStorage(const MappedStorage &) = delete;
+    MappedStorage &operator=(const MappedStorage &) = delete;
+
+    /**
+     * @brief Syncs the live object & marks the file as cleanly closed
+     */
+    ~MappedStorage()
+    {
+      ::msync(pMap + mPage, mSlotSize, MS_SYNC);
+      Header header = header_of();
+      header.clean = 1;
+      std::memcpy(pMap, &header, sizeof(header));
+      ::msync(pMap, mPage, MS_SYNC);
+      ::munmap(pMap, mFileSize);
+      ::close(mFile);
+    }
+
+    Data_t &data() { return *std::launder(reinterpret_cast<Data_t *>(pMap + mPage)); }
+    const Data_t &data() const { return *std::launder(reinterpret_cast<const Data_t *>(pMap + mPage)); }
+
+    StorageOrigin origin() const { return mOrigin; }
+
+    const std::string &path() const { return mPath; }
+
+    /**
+     * @brief Number of checkpoints taken since the file was created
+     */
+    std::uint64_t checkpoints() const { return header_of().slots[newest_slot(header_of())].sequence; }
+
+    /**
+     * @brief Schedules the write back of the dirty pages of the live object, without waiting for it
+     */
+    void flush() { ::msync(pMap + mPage, mSlotSize, MS_ASYNC); }
+
+    /**
+     * @brief Copies the live object to a checkpoint slot & waits until it is on disk.
+     * The previous checkpoint stays intact until the new one is complete.
+     */
+    void checkpoint()
+    {
+      Header header = header_of();
+      std::size_t newest = newest_slot(header);
+      std::size_t slot = 1 - newest;
+      std::byte *target = slot_data(slot);
+      std::memcpy(target, pMap + mPage, sizeof(Data_t));
+      if (::msync(target, mSlotSize, MS_SYNC) != 0)
+        throw std::system_error(errno, std::generic_category(), "cannot sync mapped storage " + mPath);
+      header.slots[slot] = {header.slots[newest].sequence + 1, checksum_bytes(target, sizeof(Data_t))};
+      write_header(header);
+    }
+
+  private:
+    struct Checkpoint
+    {
+      std::uint64_t sequence; // 0 if the slot was never written
+      std::uint64_t checksum;
+    };
+
+    struct Header
+    {
+      std::uint64_t magic;
+      std::uint64_t layout;
+      std::uint64_t clean;
+      Checkpoint slots[2];
+    };
+
+    static constexpr std::uint64_t magic = 0x31534D474D4D44ull; // "DMMGMS1"
+
+    static std::uint64_t layout()
+    {
+      std::uint64_t name = std::hash<std::string_view>()(typeid(Data_t).name());
+      return name ^ (std::uint64_t(sizeof(Data_t)) << 8) ^ alignof(Data_t);
+    }
+
+    void open()
+    {
+      struct stat status;
+      if (::fstat(mFile, &status) != 0)
+        throw std::system_error(errno, std::generic_category(), "cannot stat mapped storage " + mPath);
+      bool existing = std::size_t(status.st_size) == mFileSize;
+      if (!existing && ::ftruncate(mFile, off_t(mFileSize)) != 0)
+        throw std::system_error(errno, std::generic_category(), "cannot size mapped storage " + mPath);
+      void *map = ::mmap(nullptr, mFileSize, PROT_READ | PROT_WRITE, MAP_SHARED, mFile, 0);
+      if (map == MAP_FAILED)
+        throw std::system_error(errno, std::generic_category(), "cannot map mapped storage " + mPath);
+      pMap = static_cast<std::byte *>(map);
+
+      Header header = header_of();
+      if (existing && header.magic == magic && header.layout == layout())
+      {
+        if (header.clean)
+          mOrigin = StorageOrigin::Restored;
+        else if (recover(header))
+          mOrigin = StorageOrigin::Recovered;
+      }
+      if (mOrigin == StorageOrigin::Created)
+      {
+        new (pMap + mPage) Data_t{};
+        write_header({magic, layout(), 0, {{0, 0}, {0, 0}}});
+        checkpoint();
+      }
+      header = header_of();
+      header.clean = 0;
+      write_header(header);
+    }
+
+    /**
+     * @brief Copies the most recent intact checkpoint to the live object
+     */
+    bool recover(const Header &header)
+    {
+      std::size_t newest = newest_slot(header);
+      for (std::size_t slot : {newest, 1 - newest})
+      {
+        const Checkpoint &checkpoint = header.slots[slot];
+        if (checkpoint.sequence && checksum_bytes(slot_data(slot), sizeof(Data_t)) == checkpoint.checksum)
+        {
+          std::memcpy(pMap + mPage, slot_data(slot), sizeof(Data_t));
+          return true;
+        }
+      }
+      return false;
+    }
+
+    static std::size_t newest_slot(const Header &header)
+    {
+      return header.slots[1].sequence > header.slots[0].sequence ? 1 : 0;
+    }
+
+    std::byte *slot_data(std::size_t slot) const { return pMap + mPage + (1 + slot) * mSlotSize; }
+
+    Header header_of() const
+    {
+      Header header;
+      std::memcpy(&header, pMap, sizeof(header));
+      return header;
+    }
+
+    void write_header(const Header &header)
+    {
+      std::memcpy(pMap, &header, sizeof(header));
+      if (::msync(pMap, mPage, MS_SYNC) != 0)
+        throw std::system_error(errno, std::generic_category(), "cannot sync mapped storage " + mPath);
+    }
+
+    std::string mPath;
+    std::size_t mPage;
+    std::size_t mSlotSize; // Bytes of the live object & of each checkpoint slot, rounded up to whole pages
+    std::size_t mFileSize;
+    int mFile = -1;
+    std::byte *pMap = nullptr;
+    StorageOrigin mOrigin = StorageOrigin::Created;
+  };
+
+  /**
+   * @brief Declares a DataManager whose data is held by a MappedStorage, as DataManager<Mapped<Data_t>>
+   */
+  template <typename Data_t>
+  struct Mapped
+  {
+  };
+} // namespace dmgmt
@@ -0,0 +1,87 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#pragma once
+
+#include <atomic>
+
+namespace dmgmt
+{
+  /**
+   * @brief Base of the objects that can be pushed to a MpscQueue
+   */
+  struct MpscNode
+  {
+    std::atomic<MpscNode *> pNext{nullptr};
+  };
+
+  /**
+   * @brief An intrusive, unbounded, lock-free multiple producers single consumer queue (Vyukov's algorithm).
+   * push is wait-free and can be called from any thread, pop must only be called from the consumer thread.
+   * The queue does not own the nodes.
+   */
+  class MpscQueue
+  {
+  public:
+    MpscQueue() noexcept
+        : pHead{&mStub},
+          pTail{&mStub}
+    {
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    void push(MpscNode *node) noexcept
+    {
+      node->pNext.store(nullptr, std::memory_order_relaxed);
+      MpscNode *previous = pHead.exchange(node, std::memory_order_acq_rel);
+      previous->pNext.store(node, std::memory_order_release);
+    }
+
+    /**
+     * @brief Returns the oldest node, or nullptr if the queue is empty
+     * or if the producer of the oldest node has not finished pushing it
+     */
+    MpscNode *pop() noexcept
+    {
+      MpscNode *tail = pTail;
+      MpscNode *next = tail->pNext.load(std::memory_order_acquire);
+      if (tail == &mStub)
+      {
+        if (!next)
+          return nullptr;
+        pTail = next;
+        tail = next;
+        next = next->pNext.load(std::memory_order_acquire);
+      }
+      if (next)
+      {
+        pTail = next;
+        return tail;
+      }
+      if (tail != pHead.load(std::memory_order_acquire))
+        return nullptr;
+      push(&mStub);
+      next = tail->pNext.load(std::memory_order_acquire);
+      if (next)
+      {
+        pTail = next;
+        return tail;
+      }
+      return nullptr;
+    }
+
+  private:
+    alignas(64) std::atomic<MpscNode *> pHead; // Last pushed node, producers side
+    alignas(64) MpscNode *pTail;               // Next node to pop, consumer side
+    MpscNode mStub;
+  };
+} // namespace dmgmt
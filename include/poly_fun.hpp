@@ -12,86 +12,204 @@
 
 #include <functional>
 #include <memory>
+#include <new>
+#include <utility>
 #include <cassert>
+#include <cstddef>
+
+#include "custom_type_utilities.hpp"
+#include "signature.hpp"
 
 namespace dmgmt
 {
-  class PolyFunDataBase
-  {
-  public:
-    virtual ~PolyFunDataBase() {}
-    virtual void operator()(const void *) const = 0;
-    virtual const std::type_info &type() const = 0;
-    virtual PolyFunDataBase *clone() const = 0;
-
-  protected:
-  };
-
-  template <typename El_t>
-  class PolyFunData : public PolyFunDataBase
-  {
-  public:
-    PolyFunData(const std::function<void(const El_t &)> &fun)
-        : mFun(fun)
-    {
-    }
-
-    ~PolyFunData() {}
-
-    void operator()(const void *data_ptr) const override
-    {
-      mFun(*static_cast<const El_t *>(data_ptr));
-    }
-
-    const std::type_info &type() const override { return typeid(El_t); }
-
-    PolyFunDataBase *clone() const override { return new PolyFunData{mFun}; }
-
-  private:
-    std::function<void(const El_t &)> mFun;
-  };
-
   /**
    * @brief An object that contains a polymorphic callable.
    * Can contain any callable with signature void(El_t) where El_t is any type.
+   * Small callables are stored inline, bigger ones on the heap.
+   * Calls go through a single function pointer chosen at construction.
    */
   class PolyFun
   {
   public:
+    /// Size of the inline buffer, callables that do not fit are heap allocated
+    static constexpr std::size_t inline_capacity = 4 * sizeof(void *);
+
+    PolyFun() noexcept = default;
+
     template <typename El_t,
               typename = std::enable_if_t<!std::is_same_v<El_t, PolyFun>>>
     PolyFun(const std::function<void(const El_t &)> &fun)
-        : mFunData{new PolyFunData<El_t>(fun)}
+        : PolyFun{fmt<El_t>(fun)}
     {
     }
 
     PolyFun(const PolyFun &other)
-        : mFunData{other.mFunData->clone()}
+        : pInvoke{other.pInvoke},
+          pManage{other.pManage},
+          pType{other.pType}
+    {
+      if (pManage)
+        pManage(Operation::Copy, mStorage, other.mStorage);
+    }
+
+    PolyFun(PolyFun &&other) noexcept
+        : pInvoke{other.pInvoke},
+          pManage{other.pManage},
+          pType{other.pType}
+    {
+      if (pManage)
+        pManage(Operation::Move, mStorage, other.mStorage);
+      other.reset();
+    }
+
+    PolyFun &operator=(const PolyFun &other)
+    {
+      if (this != &other)
+        *this = PolyFun{other};
+      return *this;
+    }
+
+    PolyFun &operator=(PolyFun &&other) noexcept
     {
+      if (this != &other)
+      {
+        reset();
+        pInvoke = other.pInvoke;
+        pManage = other.pManage;
+        pType = other.pType;
+        if (pManage)
+          pManage(Operation::Move, mStorage, other.mStorage);
+        other.reset();
+      }
+      return *this;
     }
 
+    ~PolyFun() { reset(); }
+
+    explicit operator bool() const noexcept { return pInvoke != nullptr; }
+
+    /**
+     * @brief Identifier of the argument type of the contained callable
+     */
+    type_id_t type_id() const noexcept { return pType; }
+
     template <typename El_t>
     void operator()(const El_t &data) const
     {
-      if (typeid(El_t) == mFunData->type())
-        (*mFunData.get())(&data);
-      else
-        assert(false);
+      assert(dmgmt::type_id<El_t>() == pType);
+      pInvoke(mStorage, &data);
+    }
+
+    /**
+     * @brief Calls the contained callable with the element designated by a Signature.
+     * The Signature type is not checked: callbacks are keyed by Signature,
+     * so the type already matched when the callable was registered.
+     * @param sig Signature of the element, its type must match the callable argument type
+     */
+    void invoke(const Signature &sig) const
+    {
+      pInvoke(mStorage, sig.address());
     }
 
     /**
      * @brief Formats any functor to a type handlable by PolyFun
      * @tparam Dat_t Type of the argument handled by the functor
      * @param functor a functor with void(const Dat_t&) signature
-     * @return Functor properly converted to type std::function<void(const Dat_t&)>
+     * @return PolyFun containing the functor
      */
     template <typename Dat_t, typename Functor_t>
-    static std::function<void(const Dat_t &)> fmt(const Functor_t &functor)
+    static PolyFun fmt(Functor_t &&functor)
     {
-      return functor;
+      using F = std::decay_t<Functor_t>;
+      static_assert(std::is_invocable_v<F &, const Dat_t &>,
+                    "functor cannot be called with the element type");
+
+      PolyFun result;
+      result.pInvoke = &Model<Dat_t, F>::invoke;
+      result.pManage = &Model<Dat_t, F>::manage;
+      result.pType = dmgmt::type_id<Dat_t>();
+      Model<Dat_t, F>::create(result.mStorage, std::forward<Functor_t>(functor));
+      return result;
     }
 
   private:
-    std::unique_ptr<PolyFunDataBase> mFunData;
+    enum class Operation
+    {
+      Copy,
+      Move,
+      Destroy
+    };
+
+    using invoke_t = void (*)(const void *storage, const void *element);
+    using manage_t = void (*)(Operation op, void *storage, const void *other);
+
+    template <typename El_t, typename F>
+    struct Model
+    {
+      static constexpr bool is_inline = sizeof(F) <= inline_capacity &&
+                                        alignof(F) <= alignof(std::max_align_t) &&
+                                        std::is_nothrow_move_constructible_v<F>;
+
+      static F *get(const void *storage)
+      {
+        if constexpr (is_inline)
+          return std::launder(reinterpret_cast<F *>(const_cast<void *>(storage)));
+        else
+          return *static_cast<F *const *>(storage);
+      }
+
+      template <typename Arg_t>
+      static void create(void *storage, Arg_t &&functor)
+      {
+        if constexpr (is_inline)
+          new (storage) F(std::forward<Arg_t>(functor));
+        else
+          *static_cast<F **>(storage) = new F(std::forward<Arg_t>(functor));
+      }
+
+      static void invoke(const void *storage, const void *element)
+      {
+        (*get(storage))(*static_cast<const El_t *>(element));
+      }
+
+      static void manage(Operation op, void *storage, const void *other)
+      {
+        switch (op)
+        {
+        case Operation::Copy:
+          create(storage, *get(other));
+          break;
+        case Operation::Move:
+          if constexpr (is_inline)
+            create(storage, std::move(*get(other)));
+          else
+          {
+            *static_cast<F **>(storage) = get(other);
+            *static_cast<F **>(const_cast<void *>(other)) = nullptr;
+          }
+          break;
+        case Operation::Destroy:
+          if constexpr (is_inline)
+            get(storage)->~F();
+          else
+            delete get(storage);
+          break;
+        }
+      }
+    };
+
+    void reset() noexcept
+    {
+      if (pManage)
+        pManage(Operation::Destroy, mStorage, nullptr);
+      pInvoke = nullptr;
+      pManage = nullptr;
+      pType = nullptr;
+    }
+
+    alignas(std::max_align_t) unsigned char mStorage[inline_capacity];
+    invoke_t pInvoke = nullptr;
+    manage_t pManage = nullptr;
+    type_id_t pType = nullptr;
   };
 } // namespace dmgmt
@@ -0,0 +1,179 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <cstddef>
+
+#include "poly_fun.hpp"
+#include "signature.hpp"
+
+namespace dmgmt
+{
+  /**
+   * @brief A callback to call during a propagation, with the element it is called with
+   */
+  struct PropagationStep
+  {
+    Signature element;
+    const PolyFun *callback;
+  };
+
+  /**
+   * @brief The callbacks to call after some elements changed, in the order they are called
+   */
+  using PropagationPlan = std::vector<PropagationStep>;
+
+  /**
+   * @brief Counters of a PlanCompiler
+   */
+  struct CompileStats
+  {
+    std::size_t compilations; // Plans compiled since the creation of the compiler
+    std::size_t visited;      // Elements reached by the last compilation
+    std::size_t depth;        // Depth of the last compilation search, the changed elements being at depth 1
+  };
+
+  /**
+   * @brief Compiles propagation plans from the callbacks & dependencies of a manager.
+   *
+   * The elements reachable from the changed elements through the dependencies are sorted topologically,
+   * so that an element's callbacks are called after the callbacks of every element it depends on.
+   * Dependency cycles are condensed into a single node (Tarjan's strongly connected components):
+   * each reachable element has its callbacks called exactly once.
+   *
+   * The compiler keeps its working buffers between compilations.
+   */
+  class PlanCompiler
+  {
+  public:
+    /**
+     * @brief Compiles the plan of a set of changed elements
+     * @param first, last Range of the changed elements Signatures
+     * @param successors Callable with void(const Signature &source, std::vector<Signature> &destinations) signature,
+     * appending the elements depending on source to destinations
+     * @param plan Plan the steps are appended to
+     * @param callbacks Multimaps from an element Signature to pointers to its callbacks,
+     * an element's callbacks are called in the order of the multimaps
+     */
+    template <typename Iterator_t, typename Successors_t, typename... CallbackMaps_t>
+    void compile(Iterator_t first, Iterator_t last, const Successors_t &successors, PropagationPlan &plan,
+                 const CallbackMaps_t &... callbacks)
+    {
+      auto visit = [&](const Signature &sig) {
+        mNodes.insert({sig, Node{mIndex, mIndex, true}});
+        ++mIndex;
+        mStack.push_back(sig);
+        std::size_t begin = mSuccessors.size();
+        successors(sig, mSuccessors);
+        mFrames.push_back({sig, begin, begin, mSuccessors.size()});
+        mStats.depth = std::max(mStats.depth, mFrames.size());
+      };
+
+      ++mStats.compilations;
+      mStats.depth = 0;
+
+      for (; first != last; ++first)
+      {
+        if (mNodes.find(*first) != mNodes.end())
+          continue;
+        visit(*first);
+        while (!mFrames.empty()) // Iterative depth first search, deep chains would overflow the call stack
+        {
+          Frame &frame = mFrames.back();
+          if (frame.next != frame.end)
+          {
+            Signature destination = mSuccessors[frame.next++]; // Copied: visiting appends to mSuccessors
+            auto found = mNodes.find(destination);
+            if (found == mNodes.end())
+              visit(destination);
+            else if (found->second.onStack)
+            {
+              Node &node = mNodes.find(frame.element)->second;
+              node.lowLink = std::min(node.lowLink, found->second.index);
+            }
+            continue;
+          }
+
+          Signature element = frame.element;
+          mSuccessors.resize(frame.begin);
+          mFrames.pop_back();
+          Node &node = mNodes.find(element)->second;
+          if (node.lowLink == node.index) // Root of a component: pop it
+          {
+            Signature member;
+            do
+            {
+              member = mStack.back();
+              mStack.pop_back();
+              mNodes.find(member)->second.onStack = false;
+              mOrder.push_back(member);
+            } while (member != element);
+          }
+          if (!mFrames.empty())
+          {
+            Node &parent = mNodes.find(mFrames.back().element)->second;
+            parent.lowLink = std::min(parent.lowLink, node.lowLink);
+          }
+        }
+      }
+
+      // Components are completed in reverse topological order
+      for (auto it = mOrder.rbegin(); it != mOrder.rend(); ++it)
+        (append(*it, callbacks, plan), ...);
+
+      mStats.visited = mIndex;
+      mNodes.clear();
+      mOrder.clear();
+      mIndex = 0;
+    }
+
+    const CompileStats &stats() const { return mStats; }
+
+  private:
+    template <typename CallbackMap_t>
+    static void append(const Signature &element, const CallbackMap_t &callbacks, PropagationPlan &plan)
+    {
+      auto range = callbacks.equal_range(element);
+      for (auto start = range.first; start != range.second; ++start)
+        plan.push_back({element, start->second});
+    }
+
+    struct Node
+    {
+      std::size_t index;
+      std::size_t lowLink;
+      bool onStack;
+    };
+
+    /**
+     * @brief An element being visited, with the range of its destinations in mSuccessors
+     */
+    struct Frame
+    {
+      Signature element;
+      std::size_t begin;
+      std::size_t next;
+      std::size_t end;
+    };
+
+    std::unordered_map<Signature, Node> mNodes;
+    std::vector<Frame> mFrames;
+    std::vector<Signature> mSuccessors;
+    std::vector<Signature> mStack;
+    std::vector<Signature> mOrder;
+    std::size_t mIndex = 0;
+    CompileStats mStats{0, 0, 0};
+  };
+} // namespace dmgmt
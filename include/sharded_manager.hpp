@@ -0,0 +1,342 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include "mpsc_queue.hpp"
+#include "signature.hpp"
+#include "static_data_manager.hpp"
+
+namespace dmgmt
+{
+  /**
+   * @brief Counters of the messages a ShardedManager sent between its shards
+   */
+  struct ShardStats
+  {
+    std::uint64_t batches;   // Messages sent from a shard to another
+    std::uint64_t forwarded; // Changed elements the messages held
+    std::uint64_t failed;    // Tasks that threw, their exception is dropped
+  };
+
+  /**
+   * @brief Elements partitioned across StaticDataManager shards, each with its own callbacks, dependencies & history,
+   * driven by its own thread.
+   *
+   * An element belongs to the shard its memory was placed in with place() (shard 0 if it was not placed):
+   * its changes & the calls of its callbacks happen on that shard's thread.
+   * Work is posted to a shard as tasks over a lock-free MpscQueue, which the shard thread runs in rounds.
+   * A dependency between elements of different shards is a callback on the source shard, queueing the destination
+   * in an outbox. The outboxes are flushed at the end of each round, as one message per destination shard,
+   * whose thread then propagates the changes of the destinations like its own.
+   * Cross-shard dependencies must not form cycles: each message would trigger the next one.
+   * An exception thrown by a task, or by the callbacks it calls, is dropped by the shard thread, which goes on with the next tasks.
+   */
+  class ShardedManager
+  {
+  public:
+    explicit ShardedManager(std::size_t shards = std::max(1u, std::thread::hardware_concurrency()))
+    {
+      shards = std::max<std::size_t>(shards, 1);
+      mShards.reserve(shards);
+      for (std::size_t i = 0; i < shards; ++i)
+      {
+        mShards.push_back(std::make_unique<Shard>());
+        mShards.back()->outboxes.resize(shards);
+      }
+      for (auto &shard : mShards)
+        shard->thread = std::thread{[this, s = shard.get()]() { run(*s); }};
+    }
+
+    ShardedManager(const ShardedManager &) = delete;
+    ShardedManager &operator=(const ShardedManager &) = delete;
+
+    /**
+     * @brief Waits for the posted tasks & the messages they sent, then stops the shard threads
+     */
+    ~ShardedManager()
+    {
+      wait();
+      for (auto &shard : mShards)
+      {
+        {
+          std::lock_guard<std::mutex> lock{shard->mutex};
+          shard->stop = true;
+        }
+        shard->wake.notify_one();
+      }
+      for (auto &shard : mShards)
+        shard->thread.join();
+    }
+
+    std::size_t shards() const { return mShards.size(); }
+
+    /**
+     * @brief Places an element, and the elements it contains, in a shard.
+     * Placements are not synchronized: place elements before posting work that involves them.
+     * @param element Element whose memory does not overlap an element placed before
+     * @param shard Index of the shard
+     */
+    template <typename El_t>
+    void place(const El_t &element, std::size_t shard)
+    {
+      assert("shard index out of range" && shard < mShards.size());
+      Placement placement{reinterpret_cast<std::uintptr_t>(&element), reinterpret_cast<std::uintptr_t>(&element + 1), shard};
+      auto it = std::upper_bound(mPlacements.begin(), mPlacements.end(), placement.begin,
+                                 [](std::uintptr_t begin, const Placement &placed) { return begin < placed.begin; });
+      assert("placed elements cannot overlap" && (it == mPlacements.end() || placement.end <= it->begin) &&
+             (it == mPlacements.begin() || std::prev(it)->end <= placement.begin));
+      mPlacements.insert(it, placement);
+    }
+
+    /**
+     * @brief Returns the index of the shard an element belongs to
+     */
+    template <typename El_t>
+    std::size_t shard_of(const El_t &element) const
+    {
+      std::uintptr_t address = reinterpret_cast<std::uintptr_t>(&element);
+      auto it = std::upper_bound(mPlacements.begin(), mPlacements.end(), address,
+                                 [](std::uintptr_t begin, const Placement &placed) { return begin < placed.begin; });
+      if (it == mPlacements.begin() || std::prev(it)->end <= address)
+        return 0;
+      return std::prev(it)->shard;
+    }
+
+    /**
+     * @brief Runs a function on a shard thread, after the tasks posted to the shard before
+     * @param fun a functor with void(StaticDataManager &) signature, called with the shard's manager
+     */
+    template <typename F>
+    void post(std::size_t shard, F &&fun)
+    {
+      assert("shard index out of range" && shard < mShards.size());
+      _post(*mShards[shard], std::forward<F>(fun));
+    }
+
+    /**
+     * @brief Registers a callback on the shard of an element, called by the shard thread
+     */
+    template <typename El_t, typename Functor_t>
+    void register_callback(const El_t &element, Functor_t functor)
+    {
+      post(shard_of(element), [&element, functor = std::move(functor)](StaticDataManager &manager) {
+        manager.register_callback(element, functor);
+      });
+    }
+
+    /**
+     * @brief Registers a dependency between two elements, possibly of different shards
+     * @param source Source element
+     * @param destination Element which callbacks will be triggered subsequently to source change
+     */
+    template <typename Source_t, typename Destination_t>
+    void register_dependency(const Source_t &source, const Destination_t &destination)
+    {
+      std::size_t from = shard_of(source);
+      std::size_t to = shard_of(destination);
+      if (from == to)
+      {
+        post(from, [&source, &destination](StaticDataManager &manager) { manager.register_dependency(source, destination); });
+        return;
+      }
+      std::vector<Signature> *outbox = &mShards[from]->outboxes[to];
+      post(from, [&source, outbox, changed = Signature{destination}](StaticDataManager &manager) {
+        manager.register_callback(source, [outbox, changed](const Source_t &) {
+          if (outbox->empty() || outbox->back() != changed)
+            outbox->push_back(changed);
+        });
+      });
+    }
+
+    /**
+     * @brief Sets an element to a given value on its shard thread
+     */
+    template <typename El_t>
+    void set(El_t &element, std::decay_t<El_t> value)
+    {
+      post(shard_of(element), [&element, value = std::move(value)](StaticDataManager &manager) mutable {
+        manager.set(element, std::move(value));
+      });
+    }
+
+    /**
+     * @brief Undoes the last change of a shard history on its thread
+     */
+    void undo(std::size_t shard)
+    {
+      post(shard, [](StaticDataManager &manager) { manager.undo(); });
+    }
+
+    /**
+     * @brief Redoes the last undone change of a shard history on its thread
+     */
+    void redo(std::size_t shard)
+    {
+      post(shard, [](StaticDataManager &manager) { manager.redo(); });
+    }
+
+    /**
+     * @brief Blocks until every posted task has returned, and every message they sent has been propagated
+     */
+    void wait() const
+    {
+      std::unique_lock<std::mutex> lock{mIdleMutex};
+      mIdle.wait(lock, [this]() { return mPending.load(std::memory_order_acquire) == 0; });
+    }
+
+    ShardStats stats() const
+    {
+      return {mBatches.load(std::memory_order_relaxed), mForwarded.load(std::memory_order_relaxed),
+              mFailed.load(std::memory_order_relaxed)};
+    }
+
+  private:
+    static constexpr std::size_t max_round = 256; // Tasks run before the outboxes are flushed
+
+    /**
+     * @brief A posted task
+     */
+    struct Task : MpscNode
+    {
+      void (*pRun)(Task *task, StaticDataManager &manager); // Calls then destroys the task
+    };
+
+    template <typename F>
+    struct TaskModel : Task
+    {
+      explicit TaskModel(F &&fun) : mFun{std::move(fun)} { this->pRun = &run; }
+
+      static void run(Task *task, StaticDataManager &manager)
+      {
+        std::unique_ptr<TaskModel> self{static_cast<TaskModel *>(task)};
+        self->mFun(manager);
+      }
+
+      F mFun;
+    };
+
+    struct Shard
+    {
+      StaticDataManager manager;
+      MpscQueue queue;
+      std::atomic<std::size_t> depth{0};
+      std::atomic<bool> sleeping{false};
+      std::mutex mutex;
+      std::condition_variable wake;
+      bool stop = false;
+      std::vector<std::vector<Signature>> outboxes; // Per destination shard, destinations changed during the round
+      std::thread thread;
+    };
+
+    struct Placement
+    {
+      std::uintptr_t begin;
+      std::uintptr_t end;
+      std::size_t shard;
+    };
+
+    template <typename F>
+    void _post(Shard &shard, F &&fun)
+    {
+      Task *task = new TaskModel<std::decay_t<F>>(std::forward<F>(fun));
+      mPending.fetch_add(1, std::memory_order_relaxed);
+      shard.depth.fetch_add(1, std::memory_order_seq_cst);
+      shard.queue.push(task);
+      if (shard.sleeping.load(std::memory_order_seq_cst))
+      {
+        std::lock_guard<std::mutex> lock{shard.mutex};
+        shard.wake.notify_one();
+      }
+    }
+
+    /**
+     * @brief Sends the destinations changed during the round to their shards, one message per shard
+     */
+    void _flush(Shard &shard)
+    {
+      for (std::size_t to = 0; to < shard.outboxes.size(); ++to)
+      {
+        std::vector<Signature> &outbox = shard.outboxes[to];
+        if (outbox.empty())
+          continue;
+        mBatches.fetch_add(1, std::memory_order_relaxed);
+        mForwarded.fetch_add(outbox.size(), std::memory_order_relaxed);
+        _post(*mShards[to], [changed = std::move(outbox)](StaticDataManager &manager) {
+          manager.changed_elements(changed.begin(), changed.end());
+        });
+        outbox.clear();
+      }
+    }
+
+    void run(Shard &shard)
+    {
+      for (;;)
+      {
+        if (shard.depth.load(std::memory_order_seq_cst) == 0)
+        {
+          std::unique_lock<std::mutex> lock{shard.mutex};
+          shard.sleeping.store(true, std::memory_order_seq_cst);
+          shard.wake.wait(lock, [&]() { return shard.stop || shard.depth.load(std::memory_order_seq_cst); });
+          shard.sleeping.store(false, std::memory_order_relaxed);
+          if (shard.stop && shard.depth.load(std::memory_order_seq_cst) == 0)
+            return;
+        }
+
+        std::size_t done = 0;
+        for (; done < max_round; ++done)
+        {
+          auto task = static_cast<Task *>(shard.queue.pop());
+          if (!task) // Empty, or a producer is between counting & pushing its task
+            break;
+          shard.depth.fetch_sub(1, std::memory_order_relaxed);
+          try
+          {
+            task->pRun(task, shard.manager);
+          }
+          catch (...)
+          {
+            mFailed.fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+        _flush(shard); // Before the round's tasks stop counting as pending, so that wait() waits for the messages
+        if (!done)
+          std::this_thread::yield();
+        else if (mPending.fetch_sub(done, std::memory_order_acq_rel) == done)
+        {
+          std::lock_guard<std::mutex> lock{mIdleMutex};
+          mIdle.notify_all();
+        }
+      }
+    }
+
+    std::vector<std::unique_ptr<Shard>> mShards;
+    std::vector<Placement> mPlacements; // Sorted & disjoint
+    std::atomic<std::size_t> mPending{0}; // Tasks & messages posted and not run yet
+    std::atomic<std::uint64_t> mBatches{0};
+    std::atomic<std::uint64_t> mForwarded{0};
+    std::atomic<std::uint64_t> mFailed{0};
+    mutable std::mutex mIdleMutex;
+    mutable std::condition_variable mIdle; // Notified when mPending drops to 0
+  };
+} // namespace dmgmt
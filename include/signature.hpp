@@ -11,93 +11,79 @@
 #pragma once
 
 #include <functional>
-#include <memory>
+#include <type_traits>
+#include <cstdint>
 
-#include "poly_fun.hpp"
+#include "custom_type_utilities.hpp"
 
 namespace dmgmt
 {
-  class SignatureDataBase
-  {
-  public:
-    virtual ~SignatureDataBase() {}
-    virtual const std::type_info &type() const = 0;
-    virtual void invoke(const PolyFun &) const = 0;
-    virtual const void *address() const = 0;
-    virtual SignatureDataBase *clone() const = 0;
-  };
-
-  template <typename T>
-  class SignatureData : public SignatureDataBase
-  {
-  public:
-    SignatureData(const T &element) : pData{&element} {}
-    ~SignatureData() override {}
-    const void *address() const override { return pData; }
-    const std::type_info &type() const override { return typeid(T); }
-    void invoke(const PolyFun &f) const override { f(*pData); }
-    SignatureDataBase *clone() const override
-    {
-      return new SignatureData{*pData};
-    }
-
-  private:
-    const T *pData;
-  };
-
   /**
    * @brief An object that can store any variable signature (address & type)
+   * Signature is a trivially copyable pair of words: copying or comparing it never allocates.
    */
   class Signature
   {
   public:
+    constexpr Signature() noexcept = default;
+
     template <typename El_t,
               typename = std::enable_if_t<!std::is_same_v<El_t, Signature>>>
-    Signature(const El_t &element)
-        : mData{new SignatureData<El_t>{element}}
+    constexpr Signature(const El_t &element) noexcept
+        : pAddress{&element},
+          pType{dmgmt::type_id<El_t>()}
     {
     }
 
-    Signature(const Signature &other)
-        : mData{other.mData->clone()}
+    constexpr const void *address() const noexcept { return pAddress; }
+    constexpr type_id_t type_id() const noexcept { return pType; }
+    const std::type_info &type() const { return pType->info; }
+    std::size_t size() const { return pType->size; }
+
+    constexpr bool operator==(const Signature &other) const noexcept
     {
+      return pAddress == other.pAddress && pType == other.pType;
     }
 
-    const void *address() const { return mData->address(); }
-    const std::type_info &type() const { return mData->type(); }
-    void invoke(const PolyFun &f) const { mData->invoke(f); }
-
-    bool operator==(const Signature &other) const
+    constexpr bool operator!=(const Signature &other) const noexcept
     {
-      return mData->type() == other.mData->type() &&
-             mData->address() == other.mData->address();
+      return !(*this == other);
     }
 
     template <typename El_t,
               typename = std::enable_if_t<!std::is_same_v<El_t, Signature>>>
-    bool operator==(const El_t &element)
+    bool operator==(const El_t &element) const noexcept
     {
-      return mData->type() == typeid(El_t) &&
-             mData->address() == &element;
+      return pType == dmgmt::type_id<El_t>() &&
+             pAddress == &element;
     }
 
   private:
-    std::unique_ptr<SignatureDataBase> mData;
+    const void *pAddress = nullptr;
+    type_id_t pType = nullptr;
   };
+
+  static_assert(std::is_trivially_copyable_v<Signature>);
 } // namespace dmgmt
 
 namespace std
 {
+  /**
+   * @brief Mixes the address & type words so that neighbouring elements spread over all the bits,
+   * open-addressing tables index with the low bits
+   */
   template <>
   class hash<dmgmt::Signature>
   {
   public:
     std::size_t operator()(const dmgmt::Signature &s) const
     {
-      std::size_t h1 = std::hash<const void *>()(s.address());
-      std::size_t h2 = std::hash<const std::type_info *>()(&s.type());
-
-      return h1 ^ h2;
+      std::uint64_t h = std::uint64_t(reinterpret_cast<std::uintptr_t>(s.address())) * 0x9E3779B97F4A7C15ull;
+      h ^= std::uint64_t(reinterpret_cast<std::uintptr_t>(s.type_id()));
+      h ^= h >> 32;
+      h *= 0xD6E8FEB86659FD93ull;
+      h ^= h >> 32;
+      return std::size_t(h);
     }
   };
-} // namespace std
\ No newline at end of file
+} // namespace std
@@ -10,22 +10,108 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cassert>
 #include <memory>
+#include <memory_resource>
+#include <new>
 #include <typeinfo>
 #include <functional>
+#include <utility>
 #include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 
+#include "compression.hpp"
 #include "custom_type_utilities.hpp"
 #include "signature.hpp"
 
 namespace dmgmt
 {
+  /**
+   * @brief How the values of changed elements are stored in the undo/redo history
+   */
+  enum class SnapshotEncoding
+  {
+    Full, // A full copy of the element
+    Delta // Only the byte ranges that changed, for trivially copyable elements of at least delta_min_size bytes
+  };
+
+  /// Size under which storing the changed byte ranges costs more than a full copy
+  constexpr std::size_t delta_min_size = 64;
+
+  template <typename T>
+  constexpr bool is_delta_encodable_v = std::is_trivially_copyable_v<T> && sizeof(T) >= delta_min_size;
+
+  /// Size under which compressing a snapshot is not worth the CPU it costs
+  constexpr std::size_t compress_min_size = 256;
+
+  template <typename T>
+  constexpr bool is_compressible_v = std::is_trivially_copyable_v<T> && sizeof(T) >= compress_min_size;
+
+  /**
+   * @brief A range of bytes inside an element
+   */
+  struct ByteRange
+  {
+    std::uint32_t offset;
+    std::uint32_t length;
+  };
+
+  /**
+   * @brief Appends to ranges the byte ranges that differ between two images of an element.
+   * Ranges separated by less than sizeof(ByteRange) equal bytes are merged,
+   * storing the gap being cheaper than storing a new range.
+   */
+  inline void diff_ranges(const std::byte *lhs, const std::byte *rhs, std::size_t size, std::pmr::vector<ByteRange> &ranges)
+  {
+    constexpr std::size_t word = sizeof(std::uint64_t);
+    std::size_t i = 0;
+    while (i < size)
+    {
+      for (std::uint64_t l, r; i + word <= size; i += word)
+      {
+        std::memcpy(&l, lhs + i, word);
+        std::memcpy(&r, rhs + i, word);
+        if (l != r)
+          break;
+      }
+      while (i < size && lhs[i] == rhs[i])
+        ++i;
+      if (i == size)
+        break;
+
+      std::size_t end = i + 1;
+      for (std::size_t j = end, equal = 0; j < size && equal < sizeof(ByteRange); ++j)
+      {
+        if (lhs[j] != rhs[j])
+        {
+          end = j + 1;
+          equal = 0;
+        }
+        else
+          ++equal;
+      }
+      ranges.push_back({std::uint32_t(i), std::uint32_t(end - i)});
+      i = end;
+    }
+  }
+
   class SnapshotDataBase
   {
   public:
     virtual ~SnapshotDataBase(){};
 
-    virtual SnapshotDataBase *clone() const = 0;
+    /**
+     * @brief Copies the snapshot into memory obtained from a memory resource
+     */
+    virtual SnapshotDataBase *clone(std::pmr::memory_resource *resource) const = 0;
+
+    /**
+     * @brief Destroys the snapshot and gives its memory back to the resource it was obtained from
+     */
+    virtual void destroy(std::pmr::memory_resource *resource) = 0;
 
     bool operator==(const SnapshotDataBase &other) const
     {
@@ -49,8 +135,61 @@ namespace dmgmt
              &element == address();
     }
 
+    bool holds(const Signature &sig) const { return signature() == sig; }
+
+    virtual Signature signature() const = 0;
+
     virtual void rollback(std::function<void(const Signature &)> callback = nullptr) = 0;
 
+    /**
+     * @brief Updates the stored value with the current value of the element
+     */
+    virtual void capture() = 0;
+
+    /**
+     * @brief Stores the current value of the element if the snapshot does not hold a value yet
+     */
+    virtual void hold() {}
+
+    /**
+     * @brief Writes the stored bytes into an image of the element
+     * @return false if the stored value cannot be represented as bytes
+     */
+    virtual bool overlay(void *image) const = 0;
+
+    /**
+     * @brief Whether only some byte ranges of the element are stored
+     */
+    virtual bool is_delta() const { return false; }
+
+    /**
+     * @brief Calls a function with each stored byte range of the element and the bytes stored for it
+     * @return false if the stored value cannot be represented as bytes
+     */
+    virtual bool visit_bytes(const std::function<void(ByteRange, const std::byte *)> &visitor) const = 0;
+
+    /**
+     * @brief Whether the stored bytes are compressed
+     */
+    virtual bool is_compressed() const { return false; }
+
+    /**
+     * @brief Creates a compressed copy of the snapshot in memory obtained from a memory resource
+     * @param buffer Scratch buffer for the compressed bytes
+     * @return nullptr if the snapshot cannot be compressed or if compressing it does not save memory
+     */
+    virtual SnapshotDataBase *compress(std::pmr::memory_resource *resource, std::pmr::vector<std::byte> &buffer) const
+    {
+      (void)resource;
+      (void)buffer;
+      return nullptr;
+    }
+
+    /**
+     * @brief The stored value, nullptr if only some byte ranges of the element are stored
+     */
+    const void *value() const { return data(); }
+
   protected:
     virtual const std::type_info &type() const = 0;
     virtual const void *address() const = 0;
@@ -58,19 +197,135 @@ namespace dmgmt
     virtual bool has_same_data(const void *) const = 0;
   };
 
+  /**
+   * @brief A snapshot storing the bytes of a trivially copyable element compressed with lz_compress.
+   * The compressed bytes are stored right after the object, in the same allocation.
+   * They are decompressed straight into the element on rollback, the snapshot never holds them uncompressed.
+   */
+  class CompressedSnapshotData : public SnapshotDataBase
+  {
+  public:
+    ~CompressedSnapshotData() override {}
+
+    /**
+     * @param sig Signature of the element
+     * @param compressed Bytes of the element value compressed with lz_compress
+     */
+    static CompressedSnapshotData *create(std::pmr::memory_resource *resource, const Signature &sig,
+                                          const std::pmr::vector<std::byte> &compressed)
+    {
+      void *storage = resource->allocate(allocation_size(compressed.size()), alignof(CompressedSnapshotData));
+      auto snapshot = new (storage) CompressedSnapshotData{sig, compressed.size()};
+      std::memcpy(snapshot->bytes(), compressed.data(), compressed.size());
+      return snapshot;
+    }
+
+    static std::size_t allocation_size(std::size_t bytes) { return sizeof(CompressedSnapshotData) + bytes; }
+
+    SnapshotDataBase *clone(std::pmr::memory_resource *resource) const override
+    {
+      void *storage = resource->allocate(allocation_size(mBytes), alignof(CompressedSnapshotData));
+      auto snapshot = new (storage) CompressedSnapshotData{mSignature, mBytes};
+      std::memcpy(snapshot->bytes(), bytes(), mBytes);
+      return snapshot;
+    }
+
+    void destroy(std::pmr::memory_resource *resource) override
+    {
+      std::size_t size = allocation_size(mBytes);
+      this->~CompressedSnapshotData();
+      resource->deallocate(this, size, alignof(CompressedSnapshotData));
+    }
+
+    void rollback(std::function<void(const Signature &)> callback = nullptr) override
+    {
+      overlay(const_cast<void *>(mSignature.address()));
+      if (callback)
+        callback(mSignature);
+    }
+
+    /**
+     * @brief The compressed bytes cannot grow in place: snapshots are decompressed before their entry accepts changes again
+     */
+    void capture() override { assert(!"a compressed snapshot cannot capture a new value"); }
+
+    Signature signature() const override { return mSignature; }
+
+    bool overlay(void *image) const override
+    {
+      [[maybe_unused]] bool valid = lz_decompress(bytes(), mBytes, static_cast<std::byte *>(image), mSignature.size());
+      assert(valid);
+      return true;
+    }
+
+    bool visit_bytes(const std::function<void(ByteRange, const std::byte *)> &visitor) const override
+    {
+      std::vector<std::byte> image(mSignature.size());
+      overlay(image.data());
+      visitor({0, std::uint32_t(image.size())}, image.data());
+      return true;
+    }
+
+    bool is_compressed() const override { return true; }
+
+  private:
+    CompressedSnapshotData(const Signature &sig, std::size_t bytes)
+        : mSignature{sig},
+          mBytes{bytes}
+    {
+    }
+
+    std::byte *bytes() const { return reinterpret_cast<std::byte *>(const_cast<CompressedSnapshotData *>(this) + 1); }
+
+    bool has_same_data(const void *data_ptr) const override
+    {
+      if (!data_ptr)
+        return false;
+      std::vector<std::byte> image(mSignature.size());
+      overlay(image.data());
+      return std::memcmp(data_ptr, image.data(), image.size()) == 0;
+    }
+
+    const void *data() const override { return nullptr; }
+
+    const std::type_info &type() const override { return mSignature.type(); }
+    const void *address() const override { return mSignature.address(); }
+
+    Signature mSignature;
+    std::size_t mBytes; // Number of compressed bytes
+  };
+
   template <typename T>
   class SnapshotData : public SnapshotDataBase
   {
   public:
-    SnapshotData(T &element)
-        : mData{element},
-          pAddress{&element}
+    ~SnapshotData() override {}
+
+    template <typename... Args_t>
+    static SnapshotData *create(std::pmr::memory_resource *resource, Args_t &&... args)
     {
+      void *storage = resource->allocate(sizeof(SnapshotData), alignof(SnapshotData));
+      try
+      {
+        return new (storage) SnapshotData(std::forward<Args_t>(args)...);
+      }
+      catch (...)
+      {
+        resource->deallocate(storage, sizeof(SnapshotData), alignof(SnapshotData));
+        throw;
+      }
     }
 
-    ~SnapshotData() override {}
+    SnapshotDataBase *clone(std::pmr::memory_resource *resource) const override
+    {
+      return create(resource, mData, pAddress);
+    }
 
-    SnapshotDataBase *clone() const override { return new SnapshotData(mData, pAddress); }
+    void destroy(std::pmr::memory_resource *resource) override
+    {
+      this->~SnapshotData();
+      resource->deallocate(this, sizeof(SnapshotData), alignof(SnapshotData));
+    }
 
     void rollback(std::function<void(const Signature &)> callback = nullptr) override
     {
@@ -79,15 +334,73 @@ namespace dmgmt
         callback({*pAddress});
     }
 
+    void capture() override { mData = *pAddress; }
+
+    Signature signature() const override { return {*pAddress}; }
+
+    bool overlay(void *image) const override
+    {
+      if constexpr (std::is_trivially_copyable_v<T>)
+      {
+        std::memcpy(image, &mData, sizeof(T));
+        return true;
+      }
+      else
+      {
+        (void)image;
+        return false;
+      }
+    }
+
+    bool visit_bytes(const std::function<void(ByteRange, const std::byte *)> &visitor) const override
+    {
+      if constexpr (std::is_trivially_copyable_v<T>)
+      {
+        visitor({0, std::uint32_t(sizeof(T))}, reinterpret_cast<const std::byte *>(&mData));
+        return true;
+      }
+      else
+      {
+        (void)visitor;
+        return false;
+      }
+    }
+
+    SnapshotDataBase *compress(std::pmr::memory_resource *resource, std::pmr::vector<std::byte> &buffer) const override
+    {
+      if constexpr (is_compressible_v<T>)
+      {
+        buffer.clear();
+        lz_compress(reinterpret_cast<const std::byte *>(&mData), sizeof(T), buffer);
+        if (CompressedSnapshotData::allocation_size(buffer.size()) < sizeof(SnapshotData))
+          return CompressedSnapshotData::create(resource, signature(), buffer);
+      }
+      return SnapshotDataBase::compress(resource, buffer);
+    }
+
   private:
+    SnapshotData(T &element)
+        : mData{element},
+          pAddress{&element}
+    {
+    }
+
     SnapshotData(const T &value, T *address)
         : mData{value},
           pAddress{address}
     {
     }
 
+    SnapshotData(T &&value, T *address)
+        : mData{std::move(value)},
+          pAddress{address}
+    {
+    }
+
     bool has_same_data(const void *data_ptr) const override
     {
+      if (!data_ptr)
+        return false;
       if constexpr (has_operator_equal_v<T>)
         return mData == *static_cast<const T *>(data_ptr);
       else
@@ -106,38 +419,365 @@ namespace dmgmt
     T *pAddress;
   };
 
+  /**
+   * @brief A snapshot of the value an element was just given, that leaves the value in the element:
+   * it is only copied by hold(), e.g. when the change is undone, the element then gets another value.
+   * Until then the snapshot holds no value and cannot be represented as bytes.
+   */
+  template <typename T>
+  class DeferredSnapshotData : public SnapshotDataBase
+  {
+  public:
+    ~DeferredSnapshotData() override
+    {
+      if (mHeld)
+        mData.~T();
+    }
+
+    static DeferredSnapshotData *create(std::pmr::memory_resource *resource, T &element)
+    {
+      void *storage = resource->allocate(sizeof(DeferredSnapshotData), alignof(DeferredSnapshotData));
+      return new (storage) DeferredSnapshotData(element);
+    }
+
+    SnapshotDataBase *clone(std::pmr::memory_resource *resource) const override
+    {
+      if (mHeld)
+        return SnapshotData<T>::create(resource, mData, pAddress);
+      return create(resource, *pAddress);
+    }
+
+    void destroy(std::pmr::memory_resource *resource) override
+    {
+      this->~DeferredSnapshotData();
+      resource->deallocate(this, sizeof(DeferredSnapshotData), alignof(DeferredSnapshotData));
+    }
+
+    void rollback(std::function<void(const Signature &)> callback = nullptr) override
+    {
+      if (mHeld)
+        *pAddress = mData;
+      if (callback)
+        callback({*pAddress});
+    }
+
+    void capture() override
+    {
+      if (mHeld)
+        mData = *pAddress;
+      else
+      {
+        new (&mData) T(*pAddress);
+        mHeld = true;
+      }
+    }
+
+    void hold() override
+    {
+      if (!mHeld)
+        capture();
+    }
+
+    Signature signature() const override { return {*pAddress}; }
+
+    bool overlay(void *image) const override
+    {
+      if constexpr (std::is_trivially_copyable_v<T>)
+        if (mHeld)
+        {
+          std::memcpy(image, &mData, sizeof(T));
+          return true;
+        }
+      (void)image;
+      return false;
+    }
+
+    bool visit_bytes(const std::function<void(ByteRange, const std::byte *)> &visitor) const override
+    {
+      if constexpr (std::is_trivially_copyable_v<T>)
+        if (mHeld)
+        {
+          visitor({0, std::uint32_t(sizeof(T))}, reinterpret_cast<const std::byte *>(&mData));
+          return true;
+        }
+      (void)visitor;
+      return false;
+    }
+
+  private:
+    explicit DeferredSnapshotData(T &element)
+        : pAddress{&element}
+    {
+    }
+
+    bool has_same_data(const void *data_ptr) const override
+    {
+      if (!data_ptr || !mHeld)
+        return false;
+      if constexpr (has_operator_equal_v<T>)
+        return mData == *static_cast<const T *>(data_ptr);
+      else
+        return false;
+    }
+
+    const void *data() const override { return mHeld ? &mData : nullptr; }
+
+    const std::type_info &type() const override { return typeid(T); }
+    const void *address() const override { return pAddress; }
+
+    union
+    {
+      T mData; // Constructed once held
+    };
+    bool mHeld = false;
+    T *pAddress;
+  };
+
+  /**
+   * @brief A snapshot storing only some byte ranges of a trivially copyable element.
+   * The ranges and their bytes are stored right after the object, in the same allocation.
+   */
+  class DeltaSnapshotData : public SnapshotDataBase
+  {
+  public:
+    ~DeltaSnapshotData() override {}
+
+    /**
+     * @param sig Signature of the element
+     * @param ranges Byte ranges to store
+     * @param image Image of the element the bytes are copied from
+     */
+    static DeltaSnapshotData *create(std::pmr::memory_resource *resource, const Signature &sig,
+                                     const std::pmr::vector<ByteRange> &ranges, const void *image)
+    {
+      std::size_t bytes = 0;
+      for (const ByteRange &range : ranges)
+        bytes += range.length;
+
+      void *storage = resource->allocate(allocation_size(ranges.size(), bytes), alignof(DeltaSnapshotData));
+      auto delta = new (storage) DeltaSnapshotData{sig, ranges.size(), bytes};
+      if (!ranges.empty())
+        std::memcpy(delta->ranges(), ranges.data(), ranges.size() * sizeof(ByteRange));
+      delta->copy(delta->bytes(), image);
+      return delta;
+    }
+
+    /**
+     * @brief Creates a snapshot storing the whole element
+     */
+    static DeltaSnapshotData *create_full(std::pmr::memory_resource *resource, const Signature &sig, const void *image)
+    {
+      std::pmr::vector<ByteRange> ranges{{{0, std::uint32_t(sig.size())}}, resource};
+      return create(resource, sig, ranges, image);
+    }
+
+    SnapshotDataBase *clone(std::pmr::memory_resource *resource) const override
+    {
+      std::size_t size = allocation_size(mCount, mBytes);
+      void *storage = resource->allocate(size, alignof(DeltaSnapshotData));
+      auto delta = new (storage) DeltaSnapshotData{mSignature, mCount, mBytes};
+      std::memcpy(delta->ranges(), ranges(), size - sizeof(DeltaSnapshotData));
+      return delta;
+    }
+
+    void destroy(std::pmr::memory_resource *resource) override
+    {
+      std::size_t size = allocation_size(mCount, mBytes);
+      this->~DeltaSnapshotData();
+      resource->deallocate(this, size, alignof(DeltaSnapshotData));
+    }
+
+    void rollback(std::function<void(const Signature &)> callback = nullptr) override
+    {
+      overlay(const_cast<void *>(mSignature.address()));
+      if (callback)
+        callback(mSignature);
+    }
+
+    void capture() override { copy(bytes(), mSignature.address()); }
+
+    Signature signature() const override { return mSignature; }
+
+    bool overlay(void *image) const override
+    {
+      const std::byte *source = bytes();
+      for (std::size_t i = 0; i < mCount; ++i)
+      {
+        ByteRange range = range_at(i);
+        std::memcpy(static_cast<std::byte *>(image) + range.offset, source, range.length);
+        source += range.length;
+      }
+      return true;
+    }
+
+    bool is_delta() const override { return true; }
+
+    bool visit_bytes(const std::function<void(ByteRange, const std::byte *)> &visitor) const override
+    {
+      const std::byte *source = bytes();
+      for (std::size_t i = 0; i < mCount; ++i)
+      {
+        ByteRange range = range_at(i);
+        visitor(range, source);
+        source += range.length;
+      }
+      return true;
+    }
+
+  private:
+    DeltaSnapshotData(const Signature &sig, std::size_t count, std::size_t bytes)
+        : mSignature{sig},
+          mCount{count},
+          mBytes{bytes}
+    {
+    }
+
+    static std::size_t allocation_size(std::size_t count, std::size_t bytes)
+    {
+      return sizeof(DeltaSnapshotData) + count * sizeof(ByteRange) + bytes;
+    }
+
+    std::byte *ranges() const { return reinterpret_cast<std::byte *>(const_cast<DeltaSnapshotData *>(this) + 1); }
+    std::byte *bytes() const { return ranges() + mCount * sizeof(ByteRange); }
+
+    ByteRange range_at(std::size_t index) const
+    {
+      ByteRange range;
+      std::memcpy(&range, ranges() + index * sizeof(ByteRange), sizeof(ByteRange));
+      return range;
+    }
+
+    /**
+     * @brief Copies the stored ranges of an element image to a destination buffer
+     */
+    void copy(std::byte *destination, const void *image) const
+    {
+      for (std::size_t i = 0; i < mCount; ++i)
+      {
+        ByteRange range = range_at(i);
+        std::memcpy(destination, static_cast<const std::byte *>(image) + range.offset, range.length);
+        destination += range.length;
+      }
+    }
+
+    bool has_same_data(const void *data_ptr) const override
+    {
+      if (!data_ptr)
+        return false;
+      const std::byte *source = bytes();
+      for (std::size_t i = 0; i < mCount; ++i)
+      {
+        ByteRange range = range_at(i);
+        if (std::memcmp(static_cast<const std::byte *>(data_ptr) + range.offset, source, range.length) != 0)
+          return false;
+        source += range.length;
+      }
+      return true;
+    }
+
+    const void *data() const override { return nullptr; }
+
+    const std::type_info &type() const override { return mSignature.type(); }
+    const void *address() const override { return mSignature.address(); }
+
+    Signature mSignature;
+    std::size_t mCount;
+    std::size_t mBytes;
+  };
+
   /** 
    * @brief An object that stores a variable signature and its value at the time of creation of the Snapshot
-   * Useful to rollback the stored variable to its value at the creation of the Snapshot
+   * Useful to rollback the stored variable to its value at the creation of the Snapshot.
+   * The stored value lives in memory obtained from a std::pmr::memory_resource.
    */
   class Snapshot
   {
   public:
+    /**
+     * @brief Creates an empty snapshot
+     */
+    Snapshot() noexcept
+        : mData{nullptr},
+          pResource{nullptr}
+    {
+    }
+
     template <typename El_t,
               typename = std::enable_if_t<!std::is_same_v<El_t, Snapshot>>>
-    Snapshot(El_t &element)
-        : mData{new SnapshotData<El_t>{element}}
+    Snapshot(El_t &element, std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : mData{SnapshotData<El_t>::create(resource, element)},
+          pResource{resource}
     {
     }
 
     Snapshot(const Snapshot &other)
-        : mData{other.mData->clone()}
+        : mData{other.mData ? other.mData->clone(other.pResource) : nullptr},
+          pResource{other.pResource}
+    {
+    }
+
+    Snapshot(Snapshot &&other) noexcept
+        : mData{std::exchange(other.mData, nullptr)},
+          pResource{other.pResource}
+    {
+    }
+
+    Snapshot &operator=(Snapshot other) noexcept
+    {
+      std::swap(mData, other.mData);
+      std::swap(pResource, other.pResource);
+      return *this;
+    }
+
+    ~Snapshot()
     {
+      if (mData)
+        mData->destroy(pResource);
     }
 
-    Snapshot(Snapshot &&other)
-        : mData{std::move(other.mData)}
+    /**
+     * @brief Takes ownership of snapshot data allocated from a memory resource
+     */
+    static Snapshot adopt(SnapshotDataBase *data, std::pmr::memory_resource *resource) noexcept
     {
+      Snapshot snapshot;
+      snapshot.mData = data;
+      snapshot.pResource = resource;
+      return snapshot;
     }
 
     bool valid() const { return bool(mData); }
 
+    bool is_delta() const { return mData && mData->is_delta(); }
+
+    bool is_compressed() const { return mData && mData->is_compressed(); }
+
+    /**
+     * @brief Memory resource the stored value is allocated from
+     */
+    std::pmr::memory_resource *resource() const { return pResource; }
+
+    /**
+     * @brief Replaces the stored value by a compressed copy, allocated from the same memory resource
+     * @param buffer Scratch buffer for the compressed bytes
+     * @return false if the value cannot be compressed or if compressing it does not save memory
+     */
+    bool compress(std::pmr::vector<std::byte> &buffer)
+    {
+      SnapshotDataBase *compressed = mData ? mData->compress(pResource, buffer) : nullptr;
+      if (!compressed)
+        return false;
+      mData->destroy(pResource);
+      mData = compressed;
+      return true;
+    }
+
     template <typename T>
     bool operator==(const T &other) const
     {
       if (!mData)
         return false;
-      return *mData.get() == other;
+      return *mData == other;
     }
 
     template <typename T>
@@ -148,9 +788,9 @@ namespace dmgmt
 
     bool operator==(const Snapshot &other) const
     {
-      if (!mData)
+      if (!mData || !other.mData)
         return false;
-      return *mData.get() == *other.mData.get();
+      return *mData == *other.mData;
     }
 
     bool operator!=(const Snapshot &other) const
@@ -163,28 +803,75 @@ namespace dmgmt
     {
       if (!mData)
         return false;
-      return mData.get()->holds(element);
+      return mData->holds(element);
+    }
+
+    Signature signature() const { return mData ? mData->signature() : Signature{}; }
+
+    /**
+     * @brief Writes the stored bytes into an image of the element
+     * @return false if the stored value cannot be represented as bytes
+     */
+    bool overlay(void *image) const { return mData && mData->overlay(image); }
+
+    /**
+     * @brief Calls a function with each stored byte range of the element and the bytes stored for it
+     * @return false if the stored value cannot be represented as bytes
+     */
+    bool visit_bytes(const std::function<void(ByteRange, const std::byte *)> &visitor) const
+    {
+      return mData && mData->visit_bytes(visitor);
     }
 
+    /**
+     * @brief The stored value, nullptr if only some byte ranges of the element are stored
+     */
+    const void *value() const { return mData ? mData->value() : nullptr; }
+
     void rollback(std::function<void(const Signature &)> callback = nullptr)
     {
       if (!mData)
         return;
-      mData.get()->rollback(callback);
+      mData->rollback(callback);
+    }
+
+    /**
+     * @brief Updates the stored value with the current value of the element
+     */
+    void capture()
+    {
+      if (mData)
+        mData->capture();
+    }
+
+    /**
+     * @brief Stores the current value of the element if the snapshot does not hold a value yet
+     */
+    void hold()
+    {
+      if (mData)
+        mData->hold();
     }
 
   private:
-    std::unique_ptr<SnapshotDataBase> mData;
+    SnapshotDataBase *mData;
+    std::pmr::memory_resource *pResource;
   };
 
   /**
-   * @brief An object containing a vector of Snapshots
+   * @brief An object containing a vector of Snapshots.
+   * The vector and the snapshots are allocated from the group memory resource.
    */
   class SnapshotGroup
   {
   public:
     SnapshotGroup() = default;
 
+    explicit SnapshotGroup(std::pmr::memory_resource *resource)
+        : mSnapshots(resource)
+    {
+    }
+
     template <typename... Els_t>
     SnapshotGroup(Els_t &... elements)
         : mSnapshots{elements...}
@@ -199,8 +886,72 @@ namespace dmgmt
 
     std::size_t size() const { return mSnapshots.size(); }
 
+    std::pmr::memory_resource *resource() const { return mSnapshots.get_allocator().resource(); }
+
+    void reserve(std::size_t count) { mSnapshots.reserve(count); }
+
+    /**
+     * @param snapshot_resource Memory resource of the snapshot value, the group one if nullptr
+     */
+    template <typename El_t>
+    void add(El_t &element, std::pmr::memory_resource *snapshot_resource = nullptr)
+    {
+      mSnapshots.emplace_back(element, snapshot_resource ? snapshot_resource : resource());
+    }
+
+    void add(Snapshot &&snapshot) { mSnapshots.push_back(std::move(snapshot)); }
+
+    Snapshot &operator[](std::size_t index) { return mSnapshots[index]; }
+
+    /**
+     * @brief Adds a snapshot of an element unless the group already holds one
+     */
+    template <typename El_t>
+    void add_once(El_t &element, std::pmr::memory_resource *snapshot_resource = nullptr)
+    {
+      if (!find(element))
+        add(element, snapshot_resource);
+    }
+
+    /**
+     * @brief Adds a snapshot of an element. If the group already holds one,
+     * it is updated and moved last so that the group restores elements in the order of their latest change.
+     */
     template <typename El_t>
-    void add(El_t &element) { mSnapshots.push_back(element); }
+    void add_latest(El_t &element, std::pmr::memory_resource *snapshot_resource = nullptr)
+    {
+      Snapshot *snapshot = find(element);
+      if (!snapshot)
+        return add(element, snapshot_resource);
+      snapshot->capture();
+      auto it = mSnapshots.begin() + (snapshot - mSnapshots.data());
+      std::rotate(it, it + 1, mSnapshots.end());
+    }
+
+    /**
+     * @brief Returns the snapshot holding an element or nullptr if there is none
+     */
+    template <typename El_t>
+    Snapshot *find(const El_t &element)
+    {
+      for (auto &snapshot : mSnapshots)
+        if (snapshot.holds(element))
+          return &snapshot;
+      return nullptr;
+    }
+
+    /**
+     * @brief Removes the snapshot holding the element designated by a Signature, if any
+     */
+    void erase(const Signature &sig)
+    {
+      for (auto it = mSnapshots.begin(); it != mSnapshots.end(); ++it)
+        if (it->holds(sig))
+        {
+          mSnapshots.erase(it);
+          return;
+        }
+    }
 
     const Snapshot *last() const
     {
@@ -215,6 +966,15 @@ namespace dmgmt
         start->rollback(callback);
     }
 
+    /**
+     * @brief Stores the current value of the elements whose snapshot does not hold a value yet
+     */
+    void hold()
+    {
+      for (Snapshot &snapshot : mSnapshots)
+        snapshot.hold();
+    }
+
     void restore(std::function<void(const Signature &)> callback = nullptr)
     {
       for (auto start = mSnapshots.begin(); start != mSnapshots.end(); ++start)
@@ -222,6 +982,6 @@ namespace dmgmt
     }
 
   private:
-    std::vector<Snapshot> mSnapshots;
+    std::pmr::vector<Snapshot> mSnapshots;
   };
 } // namespace dmgmt
\ No newline at end of file
@@ -0,0 +1,203 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "snapshot.hpp"
+
+namespace dmgmt
+{
+  /**
+   * @brief Copy-on-write checkpoints of a region of memory, split into fixed size chunks.
+   *
+   * Taking a checkpoint only records it. The first write to a chunk after a checkpoint copies the chunk
+   * into that checkpoint (before_write must be called before the region is written),
+   * so a chunk left untouched is shared with the live region and a chunk is copied at most once per checkpoint.
+   * The value of a chunk at a checkpoint is its first copy in that checkpoint or a later one, the live chunk if there is none.
+   * Restoring a checkpoint copies back the chunks that were written since, which also drops the checkpoints taken after it.
+   */
+  class StateCheckpoints
+  {
+  public:
+    using id_t = std::uint64_t;
+
+    static constexpr std::size_t default_chunk_size = 4096;
+    static constexpr std::size_t max_size = std::numeric_limits<std::uint32_t>::max(); // Restored ranges are ByteRange
+
+    /**
+     * @param base Start of the region
+     * @param size Bytes of the region, at most max_size
+     * @param chunk_size Bytes of a chunk
+     */
+    StateCheckpoints(void *base, std::size_t size, std::size_t chunk_size = default_chunk_size)
+        : pBase{static_cast<std::byte *>(base)},
+          mSize{size},
+          mChunkSize{chunk_size},
+          mChunkEpochs((size + chunk_size - 1) / chunk_size, 0)
+    {
+      assert("checkpointed regions are limited to max_size bytes" && size <= max_size);
+    }
+
+    /**
+     * @brief Takes a checkpoint of the region, in constant time
+     */
+    id_t checkpoint()
+    {
+      mCheckpoints.push_back({++mLastId, ++mEpoch, {}});
+      return mLastId;
+    }
+
+    bool contains(id_t id) const { return find(id) != mCheckpoints.end(); }
+
+    std::size_t size() const { return mCheckpoints.size(); }
+
+    /**
+     * @brief Bytes of the chunks copied by the checkpoints
+     */
+    std::size_t saved_bytes() const
+    {
+      std::size_t chunks = 0;
+      for (const Checkpoint &checkpoint : mCheckpoints)
+        chunks += checkpoint.saved.size();
+      return chunks * mChunkSize;
+    }
+
+    /**
+     * @brief Copies the chunks of a range of bytes that are written for the first time since the last checkpoint
+     */
+    void before_write(const void *address, std::size_t size)
+    {
+      if (mCheckpoints.empty() || size == 0)
+        return;
+      std::uintptr_t offset = reinterpret_cast<std::uintptr_t>(address) - reinterpret_cast<std::uintptr_t>(pBase);
+      if (offset >= mSize)
+        return;
+      Checkpoint &last = mCheckpoints.back();
+      std::size_t end = std::min<std::size_t>((offset + size + mChunkSize - 1) / mChunkSize, mChunkEpochs.size());
+      for (std::size_t chunk = offset / mChunkSize; chunk < end; ++chunk)
+      {
+        if (mChunkEpochs[chunk] == last.epoch)
+          continue;
+        mChunkEpochs[chunk] = last.epoch;
+        auto slot = last.saved.try_emplace(chunk);
+        if (!slot.second)
+          continue;
+        slot.first->second = std::make_unique<std::byte[]>(chunk_bytes(chunk));
+        std::memcpy(slot.first->second.get(), pBase + chunk * mChunkSize, chunk_bytes(chunk));
+      }
+    }
+
+    /**
+     * @brief Brings the region back to a checkpoint, which is kept, and drops the checkpoints taken after it
+     * @param changed Filled with the byte ranges whose value was different, relative to the region start
+     * @return false if there is no such checkpoint
+     */
+    bool restore(id_t id, std::pmr::vector<ByteRange> &changed)
+    {
+      auto checkpoint = find(id);
+      if (checkpoint == mCheckpoints.end())
+        return false;
+
+      mRestored.clear();
+      for (auto it = checkpoint; it != mCheckpoints.end(); ++it)
+        for (const auto &saved : it->saved)
+          mRestored.try_emplace(saved.first, saved.second.get());
+      mOrder.clear();
+      for (const auto &restored : mRestored)
+        mOrder.push_back(restored.first);
+      std::sort(mOrder.begin(), mOrder.end());
+
+      std::pmr::vector<ByteRange> ranges;
+      for (std::size_t chunk : mOrder)
+      {
+        std::byte *live = pBase + chunk * mChunkSize;
+        const std::byte *saved = mRestored[chunk];
+        ranges.clear();
+        diff_ranges(live, saved, chunk_bytes(chunk), ranges);
+        for (const ByteRange &range : ranges)
+        {
+          std::memcpy(live + range.offset, saved + range.offset, range.length);
+          changed.push_back({std::uint32_t(chunk * mChunkSize + range.offset), range.length});
+        }
+      }
+
+      mCheckpoints.erase(checkpoint + 1, mCheckpoints.end());
+      checkpoint->saved.clear();
+      checkpoint->epoch = ++mEpoch;
+      return true;
+    }
+
+    /**
+     * @brief Drops a checkpoint, its chunk copies are handed to the previous checkpoint if it lacks them
+     */
+    void release(id_t id)
+    {
+      auto checkpoint = find(id);
+      if (checkpoint == mCheckpoints.end())
+        return;
+      if (checkpoint != mCheckpoints.begin())
+      {
+        auto previous = checkpoint - 1;
+        for (auto &saved : checkpoint->saved)
+          previous->saved.try_emplace(saved.first, std::move(saved.second));
+      }
+      mCheckpoints.erase(checkpoint);
+    }
+
+    /**
+     * @brief Drops every checkpoint
+     */
+    void clear() { mCheckpoints.clear(); }
+
+  private:
+    struct Checkpoint
+    {
+      id_t id;
+      std::uint64_t epoch; // Chunks whose epoch is this one were copied since the checkpoint was last the latest
+      std::unordered_map<std::size_t, std::unique_ptr<std::byte[]>> saved; // Chunk index to chunk copy
+    };
+
+    std::vector<Checkpoint>::iterator find(id_t id)
+    {
+      return std::find_if(mCheckpoints.begin(), mCheckpoints.end(),
+                          [id](const Checkpoint &checkpoint) { return checkpoint.id == id; });
+    }
+
+    std::vector<Checkpoint>::const_iterator find(id_t id) const
+    {
+      return std::find_if(mCheckpoints.begin(), mCheckpoints.end(),
+                          [id](const Checkpoint &checkpoint) { return checkpoint.id == id; });
+    }
+
+    std::size_t chunk_bytes(std::size_t chunk) const { return std::min(mChunkSize, mSize - chunk * mChunkSize); }
+
+    std::byte *pBase;
+    std::size_t mSize;
+    std::size_t mChunkSize;
+    std::vector<std::uint64_t> mChunkEpochs; // Epoch of the latest checkpoint when each chunk was last copied
+    std::vector<Checkpoint> mCheckpoints;    // In the order they were taken
+    id_t mLastId = 0;
+    std::uint64_t mEpoch = 0;
+
+    std::unordered_map<std::size_t, const std::byte *> mRestored;
+    std::vector<std::size_t> mOrder;
+  };
+} // namespace dmgmt
@@ -10,41 +10,108 @@
 
 #pragma once
 
-#include <unordered_map>
-#include <unordered_set>
-#include <stack>
-
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include "async_dispatcher.hpp"
+#include "change_awaitable.hpp"
+#include "computed.hpp"
 #include "custom_type_utilities.hpp"
+#include "history.hpp"
+#include "instrumentation.hpp"
 #include "snapshot.hpp"
 #include "poly_fun.hpp"
+#include "dependency_graph.hpp"
+#include "propagation_plan.hpp"
 #include "signature.hpp"
 
 namespace dmgmt
 {
+  /**
+   * @brief When callbacks are called after elements change
+   */
+  enum class PropagationMode
+  {
+    Immediate, // When the element is changed, or when the transaction is committed
+    Deferred   // When flush() is called
+  };
+
+  /**
+   * @brief When successive changes of the same element are merged into a single undo/redo entry,
+   * keeping the value before the first change & the value after the last one.
+   * Only changes of a single element made through set/call, outside transactions & groups, are merged.
+   */
+  struct CoalescingPolicy
+  {
+    std::chrono::nanoseconds window = std::chrono::nanoseconds::zero(); // Longest delay between two merged changes, zero for no limit
+    std::size_t max_operations = 1;                                     // Most changes merged into one entry, 1 for no merging
+
+    /**
+     * @brief Merges the changes of an element made less than `delay` after the previous one
+     */
+    static CoalescingPolicy within(std::chrono::nanoseconds delay)
+    {
+      return {delay, std::numeric_limits<std::size_t>::max()};
+    }
+
+    /**
+     * @brief Merges the changes of an element by groups of `count` changes
+     */
+    static CoalescingPolicy every(std::size_t count) { return {std::chrono::nanoseconds::zero(), count}; }
+  };
+
   /**
    * @brief An object that allows management of static, lifetime controlled data.
    * Allows callbacks & dependencies registration as well as undo/redo management.
+   * The callbacks to call when an element changes are compiled once into a propagation plan,
+   * which is reused until callbacks or dependencies are registered or removed.
    */
   class StaticDataManager
   {
-  private:
-    using callback_map_t = std::unordered_multimap<Signature, PolyFun>;
-    using dependency_map_t = std::unordered_multimap<Signature, Signature>;
-
   public:
-    using callback_iter_t = callback_map_t::iterator;
-    using dependency_iter_t = dependency_map_t::iterator;
+    using callback_iter_t = DependencyGraph::callback_iter_t;
+    using dependency_iter_t = DependencyGraph::dependency_iter_t;
+
+    /**
+     * @param history_resource Memory resource the undo/redo history is allocated from
+     */
+    explicit StaticDataManager(std::pmr::memory_resource *history_resource = std::pmr::get_default_resource())
+        : mHistory{history_resource}
+    {
+    }
 
     /**
      * @brief Registers a callback that will be called on every element change via StaticDataManager set/call methods calls
      * @param element Element linked to the callback
      * @param fun Function to be called
+     * @param dispatch CallbackDispatch::Async to have the callback called by a worker thread, with a copy of the element
      * @return Iterator to the registered callback
+     * @throw std::invalid_argument if dispatch is CallbackDispatch::Async and the element cannot be copied
      */
     template <typename El_t, typename Functor_t>
-    callback_iter_t register_callback(const El_t &element, const Functor_t &functor)
+    callback_iter_t register_callback(const El_t &element, const Functor_t &functor,
+                                      CallbackDispatch dispatch = CallbackDispatch::Sync)
     {
-      return mCallbacks.insert({element, PolyFun::fmt<El_t>(functor)});
+      if constexpr (std::is_copy_constructible_v<El_t>)
+      {
+        if (dispatch == CallbackDispatch::Async)
+          return mGraph.register_callback(element, _dispatcher().template wrap<El_t>(functor));
+      }
+      else if (dispatch == CallbackDispatch::Async)
+        throw std::invalid_argument("asynchronous callbacks need copyable elements");
+      return mGraph.register_callback(element, functor);
     }
 
     /**
@@ -54,7 +121,7 @@ namespace dmgmt
     template <typename El_t>
     void remove_callback(const El_t &element)
     {
-      mCallbacks.erase(element);
+      mGraph.remove_callback(element);
     }
 
     /**
@@ -63,9 +130,55 @@ namespace dmgmt
      */
     void remove_callback(const callback_iter_t &iterator)
     {
-      mCallbacks.erase(iterator);
+      mGraph.remove_callback(iterator);
     }
 
+    /**
+     * @brief Registers a value computed from elements and other computed values.
+     * It is computed on first read, then again on the first read after one of its inputs changed:
+     * propagating a change only marks it stale. When it is computed again to the same value (see same_value),
+     * the values computed from it are not computed again.
+     * Its inputs are watched through hooks of the dependency graph, which remove_callback(input) leaves in place.
+     * @param compute Function computing the value, called with the inputs (the value of computed inputs)
+     * @param inputs Elements or Computed handles the value is computed from
+     * @return Handle reading the value
+     */
+    template <typename Compute_t, typename... Inputs_t>
+    auto register_computed(Compute_t compute, const Inputs_t &... inputs)
+    {
+      auto watch = [this](const auto &input, ComputedNodeBase &node) {
+        return mGraph.register_hook(input, [computed = &mComputed, node = &node](const auto &) {
+          computed->invalidate(*node);
+        });
+      };
+      return mComputed.add(watch, std::move(compute), inputs...);
+    }
+
+    /**
+     * @brief Removes a computed value, no other computed value may be computed from it
+     * @param computed Handle returned by register_computed
+     */
+    template <typename T>
+    void remove_computed(const Computed<T> &computed)
+    {
+      mComputed.remove(computed, [this](const DependencyGraph::hook_iter_t &watch) { mGraph.remove_hook(watch); });
+    }
+
+    /**
+     * @brief Returns the number of registered computed values
+     */
+    std::size_t computed_count() const { return mComputed.size(); }
+
+    /**
+     * @brief The coroutines awaiting a change, see changed(manager, element) & set_change_scheduler(manager, scheduler)
+     */
+    ChangeWaiters &change_waiters() { return mWaiters; }
+
+    /**
+     * @brief Returns the number of coroutines awaiting a change
+     */
+    std::size_t awaiting_count() const { return mWaiters.size(); }
+
     /**
      * @brief Registers a dependency between two elements.
      * Every source element change via set/call methods will trigger destination element callbacks recursively.
@@ -76,13 +189,7 @@ namespace dmgmt
     template <typename Source_t, typename Destination_t>
     dependency_iter_t register_dependency(const Source_t &source, const Destination_t &destination)
     {
-      // First check whether the {source, destination} pair already exists
-      auto dependencies = mDependencies.equal_range(source);
-      for (auto start = dependencies.first; start != dependencies.second; ++start)
-        if (start->second == destination)
-          return start;
-      // If not register this new dependency
-      return mDependencies.insert({source, destination});
+      return mGraph.register_dependency(source, destination);
     }
 
     /**
@@ -92,7 +199,7 @@ namespace dmgmt
     template <typename El_t>
     void remove_dependency(const El_t &element)
     {
-      mDependencies.erase(element);
+      mGraph.remove_dependency(element);
     }
 
     /**
@@ -101,185 +208,613 @@ namespace dmgmt
      */
     void remove_dependency(const dependency_iter_t &iterator)
     {
-      mDependencies.erase(iterator);
+      mGraph.remove_dependency(iterator);
+    }
+
+    /**
+     * @brief Enables or disables containment dependencies, disabled by default.
+     * When enabled, a change to an element also triggers the callbacks of every element enclosing it
+     * (e.g. the structure it is a member of) that has callbacks registered, without registering dependencies.
+     */
+    void set_containment_dependencies(bool enabled) { mGraph.set_containment(enabled); }
+
+    bool containment_dependencies() const { return mGraph.containment(); }
+
+    /**
+     * @brief Whether changes propagate to more than the registered callbacks & dependencies:
+     * containment dependencies are enabled, computed values are registered or elements are awaited
+     */
+    bool runtime_propagation_needed() const
+    {
+      return containment_dependencies() || mComputed.size() || mWaiters.elements();
     }
 
     /**
-     * @brief Sets an element to a given value then calls callbacks & dependencies associated to this element
+     * @brief Number of changes made to the registered callbacks & dependencies and to containment,
+     * including the registrations made by computed values & awaited elements
+     */
+    std::size_t graph_revision() const { return mGraph.revision(); }
+
+    /**
+     * @brief Sets an element to a given value then calls callbacks & dependencies associated to this element.
+     * Nothing is recorded nor called if the element already has this value (see same_value).
      * @param element Element to be set
      * @param value New element value
-     * @param groupWithLast set to true if this change needs to be grouped with the previous one in terms of undo/redo
+     * @param groupWithLast set to true if this change needs to be grouped with the previous one in terms of undo/redo,
+     * ignored inside a transaction
      */
     template <typename El_t>
     void set(El_t &element, const El_t &value, bool groupWithLast = false)
     {
-      mDirection = Direction::Forward;
-      clear_redos();
-      if (!mUndos.size() || mUndos.top() != element)
-        mUndos.push(element);
+      if (same_value(element, value))
+        return mInstrumentation.elided();
+      auto probe = mInstrumentation.probe(InstrumentedOperation::Set, mHistory.recorded_bytes());
+      _writing(element);
+      History::Entry &entry = _entry(groupWithLast, element);
+      mHistory.record_before(entry, element);
 
       element = value;
 
-      if (groupWithLast)
-        mUndos.top().add(element);
-      else
-        mUndos.push(element);
+      mHistory.record_after(entry, element);
+      probe.recorded(mHistory.recorded_bytes());
+      mInstrumentation.changed(element);
 
-      _update(element);
+      _changed(element);
     }
 
     /**
-     * @brief Calls an element non const method then calls callbacks & dependencies associated to this element
-     * @param element Element from which the method is called
-     * @param method Pointer to one of the element's method
-     * @param args Method arguments
+     * @brief Moves a value into an element then calls callbacks & dependencies associated to this element.
+     * The previous value is moved into the undo/redo history and the new value is only copied if the change is undone,
+     * trivially copyable elements are recorded like with the copying set().
+     * @param element Element to be set
+     * @param value New element value
+     * @param groupWithLast set to true if this change needs to be grouped with the previous one in terms of undo/redo,
+     * ignored inside a transaction
+     */
+    template <typename El_t, typename = std::enable_if_t<!std::is_reference_v<El_t>>>
+    void set(El_t &element, El_t &&value, bool groupWithLast = false)
+    {
+      if constexpr (std::is_trivially_copyable_v<El_t>)
+        return set(element, static_cast<const El_t &>(value), groupWithLast);
+      else
+      {
+        if (same_value(element, static_cast<const El_t &>(value)))
+          return mInstrumentation.elided();
+        auto probe = mInstrumentation.probe(InstrumentedOperation::Set, mHistory.recorded_bytes());
+        _writing(element);
+        History::Entry &entry = _entry(groupWithLast, element);
+        mHistory.record_move(entry, element, std::move(value));
+        probe.recorded(mHistory.recorded_bytes());
+        mInstrumentation.changed(element);
+
+        _changed(element);
+      }
+    }
+
+    /**
+     * @brief Sets an element like set(), but when the change is propagated immediately,
+     * calls propagate() instead of looking up the registered callbacks.
+     * Used by managers whose callbacks & dependencies are known at compile time.
+     * @param propagate Callable that calls the callbacks of the element and its dependants
      */
-    template <typename El_t, typename... Args_t>
-    void call(El_t &element, void (El_t::*method)(Args_t...), const Args_t &... args)
+    template <typename El_t, typename Propagate_t>
+    void set_wired(El_t &element, const El_t &value, bool groupWithLast, const Propagate_t &propagate)
     {
-      mDirection = Direction::Forward;
-      clear_redos();
-      if (!mUndos.size() || mUndos.top() != element)
-        mUndos.push(element);
+      if (same_value(element, value))
+        return mInstrumentation.elided();
+      auto probe = mInstrumentation.probe(InstrumentedOperation::Set, mHistory.recorded_bytes());
+      _writing(element);
+      History::Entry &entry = _entry(groupWithLast, element);
+      mHistory.record_before(entry, element);
 
-      (element.*method)(args...);
+      element = value;
 
-      mUndos.push(element);
+      mHistory.record_after(entry, element);
+      probe.recorded(mHistory.recorded_bytes());
+      mInstrumentation.changed(element);
 
-      _update(element);
+      if (mTransactionDepth == 0 && mMode == PropagationMode::Immediate)
+        propagate();
+      else
+        _changed(element);
+    }
+
+    /**
+     * @brief Calls an element non const method then calls callbacks & dependencies associated to this element.
+     * Nothing is recorded nor called if the method leaves the element unchanged, for elements that can be compared as by same_value.
+     * @param element Element from which the method is called
+     * @param method Pointer to one of the element's method
+     * @param args Method arguments, forwarded to the method
+     */
+    template <typename El_t, typename... Params_t, typename... Args_t>
+    void call(El_t &element, void (El_t::*method)(Params_t...), Args_t &&... args)
+    {
+      _call(element, [&]() { (element.*method)(std::forward<Args_t>(args)...); });
     }
 
     /**
-     * @brief Calls an element non const method then calls callbacks & dependencies associated to this element
+     * @brief Calls an element non const method then calls callbacks & dependencies associated to this element.
+     * Nothing is recorded nor called if the method leaves the element unchanged, for elements that can be compared as by same_value.
      * @param element Element from which the method is called
      * @param method Pointer to one of the element's method
-     * @param args Method arguments
+     * @param args Method arguments, forwarded to the method
      * @return Return value of the method
      */
-    template <typename El_t, typename Ret_t, typename... Args_t,
+    template <typename El_t, typename Ret_t, typename... Params_t, typename... Args_t,
               typename = std::enable_if_t<std::is_copy_constructible_v<Ret_t>>>
-    Ret_t call(El_t &element, Ret_t (El_t::*method)(Args_t...), const Args_t &... args)
+    Ret_t call(El_t &element, Ret_t (El_t::*method)(Params_t...), Args_t &&... args)
     {
-      mDirection = Direction::Forward;
-      clear_redos();
-      if (!mUndos.size() || mUndos.top() != element)
-        mUndos.push(element);
+      std::optional<Ret_t> result;
+      _call(element, [&]() { result.emplace((element.*method)(std::forward<Args_t>(args)...)); });
+      return std::move(*result);
+    }
+
+    /**
+     * @brief Sets how the values of elements changed from now on are stored in the undo/redo history.
+     * With SnapshotEncoding::Delta, trivially copyable elements of at least delta_min_size bytes
+     * only keep the byte ranges that changed.
+     */
+    void set_snapshot_encoding(SnapshotEncoding encoding) { mHistory.set_encoding(encoding); }
 
-      Ret_t result = (element.*method)(args...);
+    /**
+     * @brief Bounds the undo/redo history, the oldest changes are forgotten first
+     * @param max_entries Maximum number of undoable changes
+     * @param max_bytes Maximum number of bytes used to store the changes
+     */
+    void set_history_limits(std::size_t max_entries, std::size_t max_bytes) { mHistory.set_limits(max_entries, max_bytes); }
 
-      mUndos.push(element);
+    /**
+     * @brief Compresses the changes that are more than a number of undo steps old, they are decompressed when undone or redone.
+     * Applies to trivially copyable elements of at least compress_min_size bytes changed from now on.
+     * @param depth Number of most recent changes kept uncompressed, History::uncompressed to stop compressing
+     */
+    void set_history_compression(std::size_t depth) { mHistory.set_compression_depth(depth); }
+
+    /**
+     * @brief Spills the changes the history limits evict to a memory mapped journal file instead of forgetting them,
+     * they are paged back in when undone. Register the serializers of the non trivially copyable elements
+     * on the journal before handing it over.
+     * @param journal Journal to spill to, nullptr to forget evicted changes again
+     */
+    void set_undo_journal(std::unique_ptr<UndoJournal> journal) { mHistory.set_journal(std::move(journal)); }
 
-      _update(element);
+    /**
+     * @brief Memory currently used by the undo/redo history
+     */
+    HistoryUsage history_usage() const { return mHistory.usage(); }
 
-      return result;
+    /**
+     * @brief Forgets every undoable & redoable change
+     */
+    void clear_history()
+    {
+      mHistory.clear();
+      mTransactionRecorded = false;
+      mCoalesced = {};
     }
 
     /**
-     * @brief Undoes last change, calls all appropriate callbacks & dependencies
-     * @return true if undo was done else false
+     * @brief Sets a function called with the Signature of every element set/call/undo/redo is about to write,
+     * before it is written
+     * @param hook Function to call, nullptr to remove it
      */
-    bool undo()
+    void set_write_hook(std::function<void(const Signature &)> hook) { mWriteHook = std::move(hook); }
+
+    /**
+     * @brief Propagates changes made to memory without set/call (e.g. a restored state):
+     * calls once the callbacks of every element overlapping a changed byte range & of their dependants.
+     * Deferred like a set() inside a transaction or in PropagationMode::Deferred.
+     * @param base Address the ranges are relative to
+     * @param ranges Changed byte ranges, sorted & disjoint
+     */
+    void changed_memory(const void *base, const std::pmr::vector<ByteRange> &ranges)
     {
-      if (mUndos.size() == 0)
-        return false;
+      if (ranges.empty())
+        return;
+      std::uintptr_t start = reinterpret_cast<std::uintptr_t>(base);
+      mGraph.for_each_element([&](const Signature &sig) {
+        std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(sig.address());
+        auto range = std::partition_point(ranges.begin(), ranges.end(), [&](const ByteRange &changed) {
+          return start + changed.offset + changed.length <= begin;
+        });
+        if (range != ranges.end() && start + range->offset < begin + sig.size() &&
+            (mChanged.empty() || mChanged.back() != sig))
+          mChanged.push_back(sig);
+      });
+      if (mTransactionDepth == 0 && mMode == PropagationMode::Immediate)
+        _propagate_changes();
+    }
+
+    /**
+     * @brief Propagates changes of elements made without set/call (e.g. by another manager):
+     * calls once the callbacks of the elements & of their dependants.
+     * Deferred like a set() inside a transaction or in PropagationMode::Deferred.
+     * @param first, last Range of the Signature of the changed elements
+     */
+    template <typename It_t>
+    void changed_elements(It_t first, It_t last)
+    {
+      for (; first != last; ++first)
+        if (mChanged.empty() || mChanged.back() != *first)
+          mChanged.push_back(*first);
+      if (mTransactionDepth == 0 && mMode == PropagationMode::Immediate)
+        _propagate_changes();
+    }
 
-      mRedos.push(mUndos.top());
-      if (mDirection == Direction::Forward && mUndos.size() > 1)
-        mUndos.pop();
+    /**
+     * @brief Hot path counters & latency histograms, recorded when DMGMT_ENABLE_INSTRUMENTATION is defined
+     * (zeros otherwise): set/call counts per element, callbacks called per propagation,
+     * dependency search sizes of the plan compilations, history bytes recorded by set/call,
+     * set/call, undo & redo latencies (callbacks included).
+     */
+    const Instrumentation &instrumentation() const { return mInstrumentation; }
 
-      mUndos.top().rollback([&](const Signature &ds) { this->_update(ds); });
-      mUndos.pop();
+    void reset_instrumentation() { mInstrumentation.reset(); }
 
-      mDirection = Direction::Backwards;
-      return true;
+    /**
+     * @brief Sets the number of worker threads calling asynchronous callbacks, hardware concurrency by default.
+     * Must be called before the first asynchronous callback is registered: callbacks hold on to their workers.
+     * @throw std::logic_error if the workers are already started
+     */
+    void set_async_workers(std::size_t count)
+    {
+      if (pDispatcher)
+        throw std::logic_error("asynchronous workers already started");
+      pDispatcher = std::make_unique<AsyncDispatcher>(count);
+    }
+
+    /**
+     * @brief Blocks until every queued asynchronous callback has returned
+     */
+    void wait_async() const
+    {
+      if (pDispatcher)
+        pDispatcher->wait();
+    }
+
+    /**
+     * @brief Queue depth & dispatch latency of the asynchronous callbacks
+     */
+    DispatchStats dispatch_stats() const
+    {
+      if (pDispatcher)
+        return pDispatcher->stats();
+      return {0, 0, std::chrono::nanoseconds{0}, std::chrono::nanoseconds{0}, 0};
+    }
+
+    /**
+     * @brief Sets when callbacks are called. Switching to PropagationMode::Immediate flushes pending changes.
+     * In PropagationMode::Deferred, set/call/undo/redo only mark the changed elements,
+     * the undo/redo history is still recorded when the change is made.
+     */
+    void set_propagation_mode(PropagationMode mode)
+    {
+      mMode = mode;
+      if (mMode == PropagationMode::Immediate && mTransactionDepth == 0)
+        flush();
+    }
+
+    PropagationMode propagation_mode() const { return mMode; }
+
+    /**
+     * @brief Calls once every callback linked to the elements changed since the last propagation & their dependants
+     */
+    void flush() { _propagate_changes(); }
+
+    /**
+     * @brief Starts a transaction. Until it is committed, changes are recorded as a single undo/redo group
+     * and callbacks are not called. Transactions can be nested, only the outermost commit has an effect.
+     */
+    void begin_transaction() { ++mTransactionDepth; }
+
+    /**
+     * @brief Commits a transaction: calls once every callback linked to the changed elements & their dependants
+     */
+    void commit_transaction()
+    {
+      assert("no transaction to commit" && mTransactionDepth);
+      if (--mTransactionDepth == 0)
+        _commit_changes();
+    }
+
+    /**
+     * @brief A transaction scope, committed when leaving the scope
+     */
+    class Transaction
+    {
+    public:
+      explicit Transaction(StaticDataManager &manager) : pManager{&manager} { pManager->begin_transaction(); }
+      Transaction(const Transaction &) = delete;
+      Transaction &operator=(const Transaction &) = delete;
+      ~Transaction() { pManager->commit_transaction(); }
+
+    private:
+      StaticDataManager *pManager;
+    };
+
+    /**
+     * @brief Starts a transaction committed at the end of the returned scope
+     */
+    [[nodiscard]] Transaction transaction() { return Transaction{*this}; }
+
+    /**
+     * @brief Sets when successive changes of the same element are merged into a single undo/redo entry,
+     * e.g. CoalescingPolicy::within(std::chrono::milliseconds{500}) or CoalescingPolicy::every(100).
+     * No changes are merged by default.
+     */
+    void set_coalescing_policy(const CoalescingPolicy &policy)
+    {
+      mCoalescing = policy;
+      mCoalesced = {};
+    }
+
+    const CoalescingPolicy &coalescing_policy() const { return mCoalescing; }
+
+    /**
+     * @brief Starts a continuous edit: until it ends, successive changes of the same element are merged
+     * into a single undo/redo entry whatever the coalescing policy. Callbacks are still called on every change.
+     * Continuous edits can be nested, only the outermost end has an effect.
+     */
+    void begin_continuous_edit()
+    {
+      if (mContinuousEdits++ == 0)
+        mCoalesced = {};
+    }
+
+    void end_continuous_edit()
+    {
+      assert("no continuous edit to end" && mContinuousEdits);
+      if (--mContinuousEdits == 0)
+        mCoalesced = {};
+    }
+
+    /**
+     * @brief A continuous edit scope, ended when leaving the scope
+     */
+    class ContinuousEdit
+    {
+    public:
+      explicit ContinuousEdit(StaticDataManager &manager) : pManager{&manager} { pManager->begin_continuous_edit(); }
+      ContinuousEdit(const ContinuousEdit &) = delete;
+      ContinuousEdit &operator=(const ContinuousEdit &) = delete;
+      ~ContinuousEdit() { pManager->end_continuous_edit(); }
+
+    private:
+      StaticDataManager *pManager;
+    };
+
+    /**
+     * @brief Starts a continuous edit ended at the end of the returned scope, e.g. while a slider is dragged
+     */
+    [[nodiscard]] ContinuousEdit continuous_edit() { return ContinuousEdit{*this}; }
+
+    /**
+     * @brief Undoes last change, calls all appropriate callbacks & dependencies
+     * Inside a transaction, the changes made so far are propagated first and the following ones form a new group.
+     * @return true if undo was done else false
+     */
+    bool undo()
+    {
+      [[maybe_unused]] auto probe = mInstrumentation.probe(InstrumentedOperation::Undo, mHistory.recorded_bytes());
+      _commit_changes();
+      mCoalesced = {};
+      if (mWriteHook)
+        mHistory.visit_undo(mWriteHook);
+      bool done = mHistory.undo([&](const Signature &ds) { mChanged.push_back(ds); });
+      if (mMode == PropagationMode::Immediate)
+        _propagate_changes();
+      return done;
     }
 
     /**
      * @brief Redoes last change, calls all appropriate callbacks & dependencies
+     * Inside a transaction, the changes made so far are propagated first and the following ones form a new group.
      * @return true if redo was done else false
      */
     bool redo()
     {
-      if (mRedos.size() == 0)
-        return false;
+      [[maybe_unused]] auto probe = mInstrumentation.probe(InstrumentedOperation::Redo, mHistory.recorded_bytes());
+      _commit_changes();
+      mCoalesced = {};
+      if (mWriteHook)
+        mHistory.visit_redo(mWriteHook);
+      bool done = mHistory.redo([&](const Signature &ds) { mChanged.push_back(ds); });
+      if (mMode == PropagationMode::Immediate)
+        _propagate_changes();
+      return done;
+    }
+
+  private:
+    AsyncDispatcher &_dispatcher()
+    {
+      if (!pDispatcher)
+        pDispatcher = std::make_unique<AsyncDispatcher>();
+      return *pDispatcher;
+    }
+
+    /**
+     * @brief Runs a change of an element, then records it and calls the callbacks unless the element is unchanged.
+     * Trivially copyable elements are compared to a byte image taken before the change, other elements with operator==
+     * to a copy, which is then moved into the history. Elements that cannot be compared are always changed.
+     * @param change Callable changing the element
+     */
+    template <typename El_t, typename Change_t>
+    void _call(El_t &element, const Change_t &change)
+    {
+      auto probe = mInstrumentation.probe(InstrumentedOperation::Set, mHistory.recorded_bytes());
+      _writing(element);
+      if constexpr (std::is_trivially_copyable_v<El_t>)
+      {
+        // The history records the element in place: it is given its previous bytes back while the change is recorded
+        auto bytes = reinterpret_cast<std::byte *>(&element);
+        mImages.assign(bytes, bytes + sizeof(El_t));
+        change();
+        if (std::memcmp(mImages.data(), bytes, sizeof(El_t)) == 0)
+          return mInstrumentation.elided();
+        mImages.insert(mImages.end(), bytes, bytes + sizeof(El_t));
+        std::memcpy(bytes, mImages.data(), sizeof(El_t));
+        History::Entry &entry = _entry(false, element);
+        mHistory.record_before(entry, element);
+        std::memcpy(bytes, mImages.data() + sizeof(El_t), sizeof(El_t));
+        mHistory.record_after(entry, element);
+      }
+      else if constexpr (has_operator_equal_v<El_t> && std::is_copy_constructible_v<El_t>)
+      {
+        El_t before = element;
+        change();
+        if (same_value(before, element))
+          return mInstrumentation.elided();
+        History::Entry &entry = _entry(false, element);
+        mHistory.record(entry, std::move(before), element);
+      }
+      else
+      {
+        History::Entry &entry = _entry(false, element);
+        mHistory.record_before(entry, element);
+        change();
+        mHistory.record_after(entry, element);
+      }
+      probe.recorded(mHistory.recorded_bytes());
+      mInstrumentation.changed(element);
 
-      mUndos.push(mRedos.top());
+      _changed(element);
+    }
+
+    void _writing(const Signature &sig)
+    {
+      if (mWriteHook)
+        mWriteHook(sig);
+    }
 
-      mRedos.top().restore([&](const Signature &ds) { this->_update(ds); });
-      mRedos.pop();
+    /**
+     * @brief Returns the history entry a change of an element is recorded in
+     */
+    History::Entry &_entry(bool groupWithLast, const Signature &sig)
+    {
+      if (mTransactionDepth)
+      {
+        groupWithLast = mTransactionRecorded;
+        mTransactionRecorded = true;
+        mCoalesced = {};
+      }
+      else if (groupWithLast)
+        mCoalesced = {}; // The entry holds several elements
+      else if (_coalesces(sig))
+        groupWithLast = true;
+      return groupWithLast ? mHistory.last() : mHistory.push();
+    }
 
-      mDirection = Direction::Forward;
+    /**
+     * @brief Whether a change of an element is merged into the last entry, tracks the element otherwise
+     */
+    bool _coalesces(const Signature &sig)
+    {
+      if (mContinuousEdits == 0 && mCoalescing.max_operations <= 1)
+        return false;
+      Coalesced last = mCoalesced;
+      mCoalesced = {sig, 1, {}};
+      if (mCoalescing.window != std::chrono::nanoseconds::zero())
+        mCoalesced.time = coalescing_clock::now();
+      if (last.element != sig || last.operations == 0)
+        return false;
+      if (mContinuousEdits == 0 &&
+          (last.operations >= mCoalescing.max_operations ||
+           (mCoalescing.window != std::chrono::nanoseconds::zero() && mCoalesced.time - last.time > mCoalescing.window)))
+        return false;
+      mCoalesced.operations = last.operations + 1;
       return true;
     }
 
-  private:
     /**
-     * @brief Calls all callbacks directly linked to the element
+     * @brief Propagates an element change, or defers it to the end of the current transaction or to flush()
      */
-    void _callback(const Signature &sig)
+    void _changed(const Signature &sig)
     {
-      mVisited.insert(sig);
-      auto range = mCallbacks.equal_range(sig);
-      for (auto start = range.first; start != range.second; ++start)
-        sig.invoke(start->second);
+      if (mTransactionDepth == 0 && mMode == PropagationMode::Immediate)
+        _propagate(sig);
+      else if (mChanged.empty() || mChanged.back() != sig)
+        mChanged.push_back(sig);
     }
 
     /**
-     * @brief Finds all elements that depend of a source element and adds them to the elements to visit
+     * @brief Ends the history entry of the current transaction, propagates its changes unless propagation is deferred
      */
-    void _find_next(const Signature &sig)
+    void _commit_changes()
     {
-      mToErase.insert(sig);
-      auto dependants = mDependencies.equal_range(sig);
-      for (auto start = dependants.first; start != dependants.second; ++start)
-        if (mVisited.find(start->second) == mVisited.end())
-          mToVisit.insert(start->second);
+      mTransactionRecorded = false;
+      if (mMode == PropagationMode::Immediate)
+        _propagate_changes();
     }
 
     /**
-     * @brief Calls alls callbacks linked to an element and its dependants recursively.
-     * Dependants are reached via a breath first search.
+     * @brief Calls once all callbacks linked to the changed elements and their dependants
      */
-    void _update(const Signature &sig)
+    void _propagate_changes()
     {
-      mToVisit.insert(sig);
-      while (mToVisit.size()) // Breath first search
+      if (mChanged.size() == 1)
       {
-        for (const auto &el : mToVisit)
-          _callback(el);
-        for (const auto &el : mToVisit)
-          _find_next(el);
-        for (const auto &el : mToErase)
-          mToVisit.erase(el);
-        mToErase.clear();
+        Signature sig = mChanged.front();
+        mChanged.clear();
+        _propagate(sig);
+      }
+      else if (mChanged.size() > 1)
+      {
+        PropagationPlan plan; // Not shared: callbacks may change elements and propagate again
+        mGraph.compile(mChanged.begin(), mChanged.end(), plan);
+        mChanged.clear();
+        mInstrumentation.compiled(mGraph.compile_stats());
+        mInstrumentation.propagated(plan.size());
+        mGraph.run(plan);
       }
-      mVisited.clear();
     }
 
-    void clear_redos()
+    /**
+     * @brief Calls all callbacks linked to an element and its dependants
+     */
+    void _propagate(const Signature &sig)
     {
-      while (mRedos.size())
-        mRedos.pop();
+      if constexpr (Instrumentation::enabled)
+      {
+        std::size_t compilations = mGraph.compile_stats().compilations;
+        const PropagationPlan &plan = mGraph.plan(sig);
+        if (mGraph.compile_stats().compilations != compilations)
+          mInstrumentation.compiled(mGraph.compile_stats());
+        mInstrumentation.propagated(plan.size());
+        mGraph.run(plan);
+      }
+      else
+        mGraph.propagate(sig);
     }
 
+    DependencyGraph mGraph;
+    ComputedGraph mComputed;
+    History mHistory;
+
+    PropagationMode mMode = PropagationMode::Immediate;
+    std::vector<Signature> mChanged; // Elements changed since the propagation was deferred
+    std::size_t mTransactionDepth = 0;
+    bool mTransactionRecorded = false; // Whether the current transaction has a history entry
+
+    using coalescing_clock = std::chrono::steady_clock;
+
     /**
-     * @brief Signals whether last modification was done in direction of the past (Backwards) or the future (Forward).
+     * @brief The element whose changes the last history entry holds, if it can be merged with
      */
-    enum class Direction
+    struct Coalesced
     {
-      Forward,
-      Backwards
+      Signature element;
+      std::size_t operations; // Changes merged into the entry, 0 if the entry cannot be merged with
+      coalescing_clock::time_point time; // Time of the last change, when the policy has a window
     };
 
-    Direction mDirection;
-
-    callback_map_t mCallbacks;
-    dependency_map_t mDependencies; // Source key, destination mapped
-    std::stack<SnapshotGroup> mUndos;
-    std::stack<SnapshotGroup> mRedos;
+    CoalescingPolicy mCoalescing;
+    Coalesced mCoalesced{{}, 0, {}};
+    std::size_t mContinuousEdits = 0;
+    Instrumentation mInstrumentation;
+    std::function<void(const Signature &)> mWriteHook; // Called before an element is written
+    std::vector<std::byte> mImages;                    // Images of an element before & after a call
+    ChangeWaiters mWaiters{mGraph}; // After the graph, which holds its hooks
 
-    std::unordered_set<Signature> mToVisit;
-    std::unordered_set<Signature> mVisited;
-    std::unordered_set<Signature> mToErase;
+    std::unique_ptr<AsyncDispatcher> pDispatcher; // Last member: queued callbacks are waited for first
   };
-} // namespace dmgmt
\ No newline at end of file
+} // namespace dmgmt
@@ -0,0 +1,265 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#pragma once
+
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <cstddef>
+
+#include "custom_type_utilities.hpp"
+
+namespace dmgmt
+{
+  /**
+   * @brief A path to an element of a data structure, as the member pointers leading to it from the structure.
+   * Path<> designates the structure itself, Path<&S::inner, &Inner::value> designates s.inner.value
+   */
+  template <auto... Members>
+  struct Path
+  {
+    template <typename Root_t>
+    static constexpr auto &resolve(Root_t &root) { return walk(root, Members...); }
+
+  private:
+    template <typename T>
+    static constexpr T &walk(T &object) { return object; }
+
+    template <typename T, typename Member_t, typename... Rest_t>
+    static constexpr auto &walk(T &object, Member_t member, Rest_t... rest) { return walk(object.*member, rest...); }
+  };
+
+  /**
+   * @brief Type of the element designated by a Path inside a Root_t structure
+   */
+  template <typename Root_t, typename Path_t>
+  using path_element_t = std::remove_reference_t<decltype(Path_t::resolve(std::declval<Root_t &>()))>;
+
+  /**
+   * @brief Statically wired callback: Function is called with the element designated by Path_t when it changes
+   */
+  template <typename Path_t, auto Function>
+  struct Callback
+  {
+    using path = Path_t;
+    static constexpr auto function = Function;
+
+    template <typename Root_t>
+    static void call(const Root_t &root) { std::invoke(Function, Path_t::resolve(root)); }
+  };
+
+  /**
+   * @brief Statically wired dependency: a change to the Source_t element triggers the Destination_t element callbacks
+   */
+  template <typename Source_t, typename Destination_t>
+  struct Depends
+  {
+    using source = Source_t;
+    using destination = Destination_t;
+  };
+
+  template <typename T>
+  struct is_callback : std::false_type
+  {
+  };
+
+  template <typename Path_t, auto Function>
+  struct is_callback<Callback<Path_t, Function>> : std::true_type
+  {
+  };
+
+  template <typename T>
+  constexpr bool is_callback_v = is_callback<T>::value;
+
+  template <typename T>
+  struct is_dependency : std::false_type
+  {
+  };
+
+  template <typename Source_t, typename Destination_t>
+  struct is_dependency<Depends<Source_t, Destination_t>> : std::true_type
+  {
+  };
+
+  template <typename T>
+  constexpr bool is_dependency_v = is_dependency<T>::value;
+
+  /**
+   * @brief The callbacks & dependencies of a Data_t structure known at compile time.
+   *
+   * Every Path used by the wiring is a node of a graph whose edges are the dependencies.
+   * The propagation order from each node is computed at compile time (depth first search, reverse post-order,
+   * each reachable node once) and propagate() expands into direct calls of the callbacks in that order.
+   *
+   * @tparam Wiring Callback & Depends declarations
+   */
+  template <typename Data_t, typename... Wiring>
+  class StaticWiring
+  {
+    static_assert(((is_callback_v<Wiring> || is_dependency_v<Wiring>) && ...),
+                  "wiring must be made of Callback & Depends declarations");
+
+    template <typename List, typename... Rest>
+    struct collect_nodes
+    {
+      typedef List type;
+    };
+
+    template <typename List, typename W, typename... Rest>
+    struct collect_nodes<List, W, Rest...>
+    {
+      template <typename T, bool = is_callback_v<T>>
+      struct paths
+      {
+        typedef append_unique_t<List, typename T::path> type;
+      };
+
+      template <typename T>
+      struct paths<T, false>
+      {
+        typedef append_unique_t<List, typename T::source, typename T::destination> type;
+      };
+
+      typedef typename collect_nodes<typename paths<W>::type, Rest...>::type type;
+    };
+
+    using nodes = typename collect_nodes<type_list<>, Wiring...>::type;
+    static constexpr std::size_t node_count = nodes::size;
+
+    template <typename Path_t, typename... Nodes>
+    static constexpr std::size_t locate(type_list<Nodes...>) { return IndexLocator<Path_t, Nodes...>::locate(); }
+
+    /**
+     * @brief Index of a Path among the nodes, node_count if the path is not wired
+     */
+    template <typename Path_t>
+    static constexpr std::size_t node_index = locate<Path_t>(nodes{});
+
+    struct Plan
+    {
+      std::size_t nodes[node_count + 1];
+      std::size_t size;
+    };
+
+    static constexpr Plan compile(std::size_t source)
+    {
+      Plan plan{{}, 0};
+      if (source >= node_count)
+        return plan;
+
+      bool edges[node_count + 1][node_count + 1]{};
+      (add_edge<Wiring>(edges), ...);
+
+      bool visited[node_count + 1]{};
+      std::size_t next[node_count + 1]{};
+      std::size_t stack[node_count + 1]{};
+      std::size_t postOrder[node_count + 1]{};
+      std::size_t depth = 0;
+      std::size_t count = 0;
+      stack[depth++] = source;
+      visited[source] = true;
+      while (depth)
+      {
+        std::size_t node = stack[depth - 1];
+        if (next[node] < node_count)
+        {
+          std::size_t destination = next[node]++;
+          if (edges[node][destination] && !visited[destination])
+          {
+            visited[destination] = true;
+            stack[depth++] = destination;
+          }
+        }
+        else
+        {
+          postOrder[count++] = node;
+          --depth;
+        }
+      }
+
+      for (std::size_t i = 0; i < count; ++i)
+        plan.nodes[i] = postOrder[count - 1 - i];
+      plan.size = count;
+      return plan;
+    }
+
+    template <typename W>
+    static constexpr void add_edge(bool (&edges)[node_count + 1][node_count + 1])
+    {
+      if constexpr (is_dependency_v<W>)
+        edges[node_index<typename W::source>][node_index<typename W::destination>] = true;
+    }
+
+    template <typename Path_t>
+    struct plan_of
+    {
+      static constexpr Plan value = compile(node_index<Path_t>);
+    };
+
+    template <typename Path_t, std::size_t... I>
+    static void call_nodes(const Data_t &data, std::index_sequence<I...>)
+    {
+      (call_node<plan_of<Path_t>::value.nodes[I]>(data), ...);
+    }
+
+    template <std::size_t Node>
+    static void call_node(const Data_t &data)
+    {
+      (call_if<Node, Wiring>(data), ...);
+    }
+
+    template <std::size_t Node, typename W>
+    static void call_if(const Data_t &data)
+    {
+      if constexpr (is_callback_v<W>)
+        if constexpr (node_index<typename W::path> == Node)
+          W::call(data);
+    }
+
+    template <typename W, typename Manager_t>
+    static void register_one(Manager_t &manager, const Data_t &data)
+    {
+      if constexpr (is_callback_v<W>)
+      {
+        using element_t = path_element_t<const Data_t, typename W::path>;
+        manager.register_callback(W::path::resolve(data), [](const element_t &element) { std::invoke(W::function, element); });
+      }
+      else
+        manager.register_dependency(W::source::resolve(data), W::destination::resolve(data));
+    }
+
+  public:
+    /**
+     * @brief Whether the element designated by Path_t has wired callbacks or dependencies
+     */
+    template <typename Path_t>
+    static constexpr bool is_wired = node_index<Path_t> != node_count;
+
+    /**
+     * @brief Calls, in dependency order, the callbacks of the elements reached from the element designated by Path_t
+     */
+    template <typename Path_t>
+    static void propagate(const Data_t &data)
+    {
+      call_nodes<Path_t>(data, std::make_index_sequence<plan_of<Path_t>::value.size>{});
+    }
+
+    /**
+     * @brief Registers the wiring into a run-time manager, so that changes made through it
+     * (run-time set/call, undo, redo) call the statically wired callbacks too
+     */
+    template <typename Manager_t>
+    static void register_into(Manager_t &manager, const Data_t &data)
+    {
+      (register_one<Wiring>(manager, data), ...);
+    }
+  };
+} // namespace dmgmt
@@ -0,0 +1,406 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "custom_type_utilities.hpp"
+#include "signature.hpp"
+#include "snapshot.hpp"
+
+namespace dmgmt
+{
+  /**
+   * @brief An append-only journal of undo/redo history entries, stored in a memory mapped file.
+   * The history spills its oldest entries to the journal instead of keeping them in memory,
+   * the kernel pages them out and back in when they are undone or redone.
+   *
+   * Snapshots of trivially copyable elements and byte deltas are written as raw bytes,
+   * other snapshots through the serializer registered for their type.
+   *
+   * Records hold element addresses, they are only meaningful to the process that wrote them:
+   * the file is created empty and removed when the journal is destroyed.
+   */
+  class UndoJournal
+  {
+  public:
+    /**
+     * @param path Path of the journal file, truncated if it exists
+     * @param capacity Initial size of the file, doubled whenever it is full
+     */
+    explicit UndoJournal(std::string path, std::size_t capacity = std::size_t{1} << 20)
+        : mPath{std::move(path)}
+    {
+      mFile = ::open(mPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+      if (mFile < 0)
+        throw std::system_error(errno, std::generic_category(), "cannot open undo journal " + mPath);
+      try
+      {
+        reserve(std::max<std::size_t>(capacity, sizeof(RecordHeader)));
+      }
+      catch (...)
+      {
+        ::close(mFile);
+        ::unlink(mPath.c_str());
+        throw;
+      }
+    }
+
+    UndoJournal(const UndoJournal &) = delete;
+    UndoJournal &operator=(const UndoJournal &) = delete;
+
+    ~UndoJournal()
+    {
+      if (pMap)
+        ::munmap(pMap, mCapacity);
+      ::close(mFile);
+      ::unlink(mPath.c_str());
+    }
+
+    /**
+     * @brief Sets how the values of elements of type T that are not trivially copyable are written & read back.
+     * Entries holding such a value with no serializer cannot be journaled.
+     * @param write Appends the bytes of a value to a buffer
+     * @param read Assigns to an element the value written in a range of bytes
+     */
+    template <typename T>
+    void register_serializer(std::function<void(const T &, std::vector<std::byte> &)> write,
+                             std::function<void(const std::byte *, std::size_t, T &)> read)
+    {
+      Serializer serializer{
+          [write = std::move(write)](const void *value, std::vector<std::byte> &out) {
+            write(*static_cast<const T *>(value), out);
+          },
+          [read = std::move(read)](const std::byte *data, std::size_t size, void *element) {
+            read(data, size, *static_cast<T *>(element));
+          }};
+      auto found = mSerializerIndex.find(type_id<T>());
+      if (found != mSerializerIndex.end())
+        mSerializers[found->second] = std::move(serializer);
+      else
+      {
+        mSerializerIndex.emplace(type_id<T>(), std::uint32_t(mSerializers.size()));
+        mSerializers.push_back(std::move(serializer));
+      }
+    }
+
+    const std::string &path() const { return mPath; }
+
+    std::size_t undo_size() const { return mCursor; }
+    std::size_t redo_size() const { return mCount - mCursor; }
+
+    /**
+     * @brief Bytes used by the records, redoable ones included
+     */
+    std::size_t size_bytes() const { return mEnd; }
+
+    /**
+     * @brief Size of the file
+     */
+    std::size_t capacity() const { return mCapacity; }
+
+    /**
+     * @brief Drops the redoable records then appends an entry as the last undoable record
+     * @return false if a snapshot of the entry cannot be written, the journal is then left unchanged
+     */
+    bool append(SnapshotGroup &before, SnapshotGroup &after)
+    {
+      clear_redos();
+      std::size_t start = mEnd;
+      try
+      {
+        RecordHeader header{0, before.size(), after.size()};
+        write(&header, sizeof(header));
+        if (!append_group(before) || !append_group(after))
+        {
+          mEnd = start;
+          return false;
+        }
+        std::uint64_t size = mEnd + sizeof(size) - start;
+        write(&size, sizeof(size));
+        std::memcpy(pMap + start, &size, sizeof(size));
+      }
+      catch (...)
+      {
+        mEnd = start;
+        throw;
+      }
+      mTop = mEnd;
+      ++mCount;
+      ++mCursor;
+      return true;
+    }
+
+    /**
+     * @brief Rolls back the last undoable record
+     * @param callback Function called with the Signature of every restored element
+     * @return true if a record was undone
+     */
+    bool undo(const std::function<void(const Signature &)> &callback = nullptr)
+    {
+      if (mCursor == 0)
+        return false;
+      std::size_t start = locate_undo();
+      for (auto item = mItems.rbegin(); item != mItems.rend(); ++item)
+        apply(*item, callback);
+      mTop = start;
+      --mCursor;
+      return true;
+    }
+
+    /**
+     * @brief Restores the first redoable record
+     * @param callback Function called with the Signature of every restored element
+     * @return true if a record was redone
+     */
+    bool redo(const std::function<void(const Signature &)> &callback = nullptr)
+    {
+      if (mCursor == mCount)
+        return false;
+      std::size_t end = locate_redo();
+      for (std::size_t item : mItems)
+        apply(item, callback);
+      mTop = end;
+      ++mCursor;
+      return true;
+    }
+
+    /**
+     * @brief Calls a function with the Signature of every element the next undo() writes
+     */
+    void visit_undo(const std::function<void(const Signature &)> &visitor)
+    {
+      if (mCursor == 0)
+        return;
+      locate_undo();
+      for (std::size_t item : mItems)
+        visitor(item_at(item).sig);
+    }
+
+    /**
+     * @brief Calls a function with the Signature of every element the next redo() writes
+     */
+    void visit_redo(const std::function<void(const Signature &)> &visitor)
+    {
+      if (mCursor == mCount)
+        return;
+      locate_redo();
+      for (std::size_t item : mItems)
+        visitor(item_at(item).sig);
+    }
+
+    /**
+     * @brief Drops every redoable record
+     */
+    void clear_redos()
+    {
+      mEnd = mTop;
+      mCount = mCursor;
+    }
+
+    /**
+     * @brief Drops every record, the file keeps its size
+     */
+    void clear()
+    {
+      mEnd = mTop = 0;
+      mCount = mCursor = 0;
+    }
+
+  private:
+    struct RecordHeader
+    {
+      std::uint64_t size; // Bytes of the record, header & trailing size included
+      std::uint64_t before;
+      std::uint64_t after;
+    };
+
+    struct ItemHeader
+    {
+      Signature sig;
+      std::uint32_t serializer; // Index of the serializer of the value, raw for byte ranges
+      std::uint32_t ranges;     // Number of byte ranges
+      std::uint64_t bytes;      // Number of bytes following the ranges
+    };
+
+    struct Serializer
+    {
+      std::function<void(const void *, std::vector<std::byte> &)> write;
+      std::function<void(const std::byte *, std::size_t, void *)> read;
+    };
+
+    static constexpr std::uint32_t raw = UINT32_MAX;
+
+    bool append_group(SnapshotGroup &group)
+    {
+      for (std::size_t i = 0; i < group.size(); ++i)
+      {
+        const Snapshot &snapshot = group[i];
+        ItemHeader header{snapshot.signature(), raw, 0, 0};
+        mRanges.clear();
+        mBuffer.clear();
+        bool bytes = snapshot.visit_bytes([this](ByteRange range, const std::byte *data) {
+          mRanges.push_back(range);
+          mBuffer.insert(mBuffer.end(), data, data + range.length);
+        });
+        if (!bytes)
+        {
+          auto found = mSerializerIndex.find(header.sig.type_id());
+          if (found == mSerializerIndex.end() || !snapshot.value())
+            return false;
+          header.serializer = found->second;
+          mSerializers[found->second].write(snapshot.value(), mBuffer);
+        }
+        header.ranges = std::uint32_t(mRanges.size());
+        header.bytes = mBuffer.size();
+        write(&header, sizeof(header));
+        write(mRanges.data(), mRanges.size() * sizeof(ByteRange));
+        write(mBuffer.data(), mBuffer.size());
+      }
+      return true;
+    }
+
+    RecordHeader record_at(std::size_t offset) const
+    {
+      RecordHeader header;
+      std::memcpy(&header, pMap + offset, sizeof(header));
+      return header;
+    }
+
+    ItemHeader item_at(std::size_t offset) const
+    {
+      ItemHeader header;
+      std::memcpy(&header, pMap + offset, sizeof(header));
+      return header;
+    }
+
+    /**
+     * @brief Stores in mItems the offsets of the before items of the last undoable record
+     * @return Offset of the record
+     */
+    std::size_t locate_undo()
+    {
+      std::uint64_t size;
+      std::memcpy(&size, pMap + mTop - sizeof(size), sizeof(size));
+      std::size_t start = mTop - size;
+      locate(start + sizeof(RecordHeader), record_at(start).before);
+      return start;
+    }
+
+    /**
+     * @brief Stores in mItems the offsets of the after items of the first redoable record
+     * @return Offset following the record
+     */
+    std::size_t locate_redo()
+    {
+      RecordHeader header = record_at(mTop);
+      locate(locate(mTop + sizeof(RecordHeader), header.before), header.after);
+      return mTop + header.size;
+    }
+
+    /**
+     * @brief Stores in mItems the offsets of consecutive items
+     * @return Offset following the items
+     */
+    std::size_t locate(std::size_t offset, std::size_t count)
+    {
+      mItems.clear();
+      for (std::size_t i = 0; i < count; ++i)
+      {
+        mItems.push_back(offset);
+        ItemHeader header = item_at(offset);
+        offset += sizeof(ItemHeader) + header.ranges * sizeof(ByteRange) + header.bytes;
+      }
+      return offset;
+    }
+
+    /**
+     * @brief Writes the value an item holds into its element
+     */
+    void apply(std::size_t offset, const std::function<void(const Signature &)> &callback)
+    {
+      ItemHeader header = item_at(offset);
+      const std::byte *data = pMap + offset + sizeof(ItemHeader);
+      void *element = const_cast<void *>(header.sig.address());
+      if (header.serializer == raw)
+      {
+        const std::byte *bytes = data + header.ranges * sizeof(ByteRange);
+        for (std::uint32_t i = 0; i < header.ranges; ++i)
+        {
+          ByteRange range;
+          std::memcpy(&range, data + i * sizeof(ByteRange), sizeof(range));
+          std::memcpy(static_cast<std::byte *>(element) + range.offset, bytes, range.length);
+          bytes += range.length;
+        }
+      }
+      else
+        mSerializers[header.serializer].read(data, header.bytes, element);
+      if (callback)
+        callback(header.sig);
+    }
+
+    void write(const void *data, std::size_t size)
+    {
+      if (size == 0)
+        return;
+      if (mEnd + size > mCapacity)
+        reserve(std::max(mCapacity * 2, mEnd + size));
+      std::memcpy(pMap + mEnd, data, size);
+      mEnd += size;
+    }
+
+    /**
+     * @brief Grows the file & maps it again
+     */
+    void reserve(std::size_t capacity)
+    {
+      if (::ftruncate(mFile, off_t(capacity)) != 0)
+        throw std::system_error(errno, std::generic_category(), "cannot grow undo journal " + mPath);
+      void *map = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, mFile, 0);
+      if (map == MAP_FAILED)
+        throw std::system_error(errno, std::generic_category(), "cannot map undo journal " + mPath);
+      if (pMap)
+        ::munmap(pMap, mCapacity);
+      pMap = static_cast<std::byte *>(map);
+      mCapacity = capacity;
+    }
+
+    std::string mPath;
+    int mFile = -1;
+    std::byte *pMap = nullptr;
+    std::size_t mCapacity = 0;
+    std::size_t mEnd = 0;    // End of the last record
+    std::size_t mTop = 0;    // End of the last undoable record
+    std::size_t mCount = 0;  // Number of records
+    std::size_t mCursor = 0; // Number of undoable records
+
+    std::vector<Serializer> mSerializers;
+    std::unordered_map<type_id_t, std::uint32_t> mSerializerIndex;
+    std::vector<ByteRange> mRanges;
+    std::vector<std::byte> mBuffer;
+    std::vector<std::size_t> mItems;
+  };
+} // namespace dmgmt
@@ -0,0 +1,104 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#include "concurrent_data_manager.hpp"
+#include "static_data_manager.hpp"
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <cassert>
+#include <cstdio>
+
+using namespace dmgmt;
+
+struct Data
+{
+  int value = 0;
+};
+
+template <typename Manager_t, typename El_t>
+void workers_set_once(Manager_t &mgr, El_t &value)
+{
+  std::atomic<int> sum{0};
+  mgr.set_async_workers(2);
+  mgr.register_callback(value, [&sum](const int &changed) { sum += changed; }, CallbackDispatch::Async);
+  mgr.set(value, 1);
+
+  // The registered callback holds on to the workers: they cannot be replaced
+  bool threw = false;
+  try
+  {
+    mgr.set_async_workers(4);
+  }
+  catch (const std::logic_error &)
+  {
+    threw = true;
+  }
+  assert(threw);
+  mgr.set(value, 2);
+  mgr.wait_async();
+  assert(sum == 3);
+}
+
+template <typename Manager_t, typename El_t>
+void wait_for_callbacks(Manager_t &mgr, El_t &value)
+{
+  std::atomic<int> last{0};
+  std::atomic<int> calls{0};
+  mgr.set_async_workers(2);
+  mgr.register_callback(value, [&](const int &changed) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    last = changed;
+    ++calls;
+  }, CallbackDispatch::Async);
+  mgr.register_callback(value, [](const int &changed) {
+    if (changed == 2)
+      throw std::runtime_error("callback failure");
+  }, CallbackDispatch::Async);
+
+  // wait_async() returns once the slow callbacks have returned
+  for (int i = 1; i <= 3; ++i)
+    mgr.set(value, i);
+  mgr.wait_async();
+  assert(calls == 3 && last == 3);
+
+  // The throwing call is dropped, its worker keeps calling the callbacks bound to it
+  assert(mgr.dispatch_stats().failed == 1);
+  assert(mgr.dispatch_stats().dispatched == 6);
+  mgr.set(value, 4);
+  mgr.wait_async();
+  assert(calls == 4 && last == 4);
+  assert(mgr.dispatch_stats().dispatched == 8);
+}
+
+int main()
+{
+  {
+    StaticDataManager mgr;
+    Data data;
+    workers_set_once(mgr, data.value);
+  }
+  {
+    ConcurrentDataManager<Data, 8> mgr;
+    workers_set_once(mgr, mgr.get().value);
+  }
+  {
+    StaticDataManager mgr;
+    Data data;
+    wait_for_callbacks(mgr, data.value);
+  }
+  {
+    ConcurrentDataManager<Data, 8> mgr;
+    wait_for_callbacks(mgr, mgr.get().value);
+  }
+  printf("async tests passed\n");
+  return 0;
+}
@@ -0,0 +1,138 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#include "data_manager.hpp"
+#include <cassert>
+#include <cstdio>
+
+using namespace dmgmt;
+
+/**
+ * @brief Elements spread over several checkpoint chunks
+ */
+struct Data
+{
+  int a = 0;
+  char gap[5000] = {};
+  int b = 0;
+  char tail[5000] = {};
+  int c = 0;
+};
+
+struct Counts
+{
+  int a = 0;
+  int b = 0;
+  int c = 0;
+};
+
+void count_callbacks(DataManager<Data> &mgr, Counts &counts)
+{
+  mgr.register_callback(mgr.get().a, [&counts](const int &) { ++counts.a; });
+  mgr.register_callback(mgr.get().b, [&counts](const int &) { ++counts.b; });
+  mgr.register_callback(mgr.get().c, [&counts](const int &) { ++counts.c; });
+}
+
+void nested_states()
+{
+  DataManager<Data> mgr;
+  Counts counts;
+  count_callbacks(mgr, counts);
+
+  auto first = mgr.save_state();
+  mgr.set(mgr.get().a, 1);
+  auto second = mgr.save_state();
+  mgr.set(mgr.get().a, 2);
+  mgr.set(mgr.get().b, 3);
+  counts = {};
+
+  // Only the elements whose bytes differ from the saved state are notified
+  assert(mgr.restore_state(second));
+  assert(mgr.get().a == 1 && mgr.get().b == 0);
+  assert(counts.a == 1 && counts.b == 1 && counts.c == 0);
+
+  assert(mgr.restore_state(first));
+  assert(mgr.get().a == 0 && mgr.get().b == 0);
+  assert(counts.a == 2 && counts.b == 1 && counts.c == 0);
+
+  // Restoring a state keeps it
+  mgr.set(mgr.get().c, 4);
+  assert(mgr.restore_state(first));
+  assert(mgr.get().c == 0 && counts.c == 2);
+}
+
+void restore_older_state()
+{
+  DataManager<Data> mgr;
+  auto first = mgr.save_state();
+  mgr.set(mgr.get().a, 1);
+  auto second = mgr.save_state();
+  mgr.set(mgr.get().b, 2);
+  auto third = mgr.save_state();
+  mgr.set(mgr.get().c, 3);
+
+  assert(mgr.restore_state(first));
+  assert(mgr.get().a == 0 && mgr.get().b == 0 && mgr.get().c == 0);
+
+  // The states saved after the restored one are dropped
+  assert(!mgr.restore_state(second));
+  assert(!mgr.restore_state(third));
+}
+
+void release_middle_state()
+{
+  DataManager<Data> mgr;
+  auto first = mgr.save_state();
+  mgr.set(mgr.get().a, 1);
+  auto second = mgr.save_state();
+  mgr.set(mgr.get().b, 2); // Its chunk is copied into the second state only
+  auto third = mgr.save_state();
+  mgr.set(mgr.get().b, 3);
+  mgr.set(mgr.get().c, 4);
+
+  // The copies of the released state are handed down to the first one
+  mgr.release_state(second);
+  assert(!mgr.restore_state(second));
+  assert(mgr.restore_state(third));
+  assert(mgr.get().a == 1 && mgr.get().b == 2 && mgr.get().c == 0);
+  assert(mgr.restore_state(first));
+  assert(mgr.get().a == 0 && mgr.get().b == 0 && mgr.get().c == 0);
+}
+
+void restore_after_undo()
+{
+  DataManager<Data> mgr;
+  Counts counts;
+  count_callbacks(mgr, counts);
+
+  auto state = mgr.save_state();
+  mgr.set(mgr.get().a, 1);
+  mgr.undo(); // a is written back to its saved value
+  mgr.set(mgr.get().b, 5);
+  counts = {};
+
+  assert(mgr.restore_state(state));
+  assert(mgr.get().a == 0 && mgr.get().b == 0);
+  assert(counts.a == 0 && counts.b == 1 && counts.c == 0);
+
+  // The undo/redo history is dropped
+  assert(!mgr.undo());
+  assert(mgr.get().b == 0);
+}
+
+int main()
+{
+  nested_states();
+  restore_older_state();
+  release_middle_state();
+  restore_after_undo();
+  printf("checkpoints tests passed\n");
+  return 0;
+}
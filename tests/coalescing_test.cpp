@@ -0,0 +1,124 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#include "static_data_manager.hpp"
+#include <chrono>
+#include <thread>
+#include <cassert>
+#include <cstdio>
+
+using namespace dmgmt;
+
+struct Data
+{
+  int a = 0;
+  int b = 0;
+};
+
+std::size_t undo_entries(const StaticDataManager &mgr) { return mgr.history_usage().undo_entries; }
+
+void by_window()
+{
+  StaticDataManager mgr;
+  Data data;
+  mgr.set_coalescing_policy(CoalescingPolicy::within(std::chrono::milliseconds{200}));
+
+  mgr.set(data.a, 1);
+  mgr.set(data.a, 2);
+  mgr.set(data.a, 3);
+  assert(undo_entries(mgr) == 1);
+
+  // A change after the window starts a new entry
+  std::this_thread::sleep_for(std::chrono::milliseconds{300});
+  mgr.set(data.a, 4);
+  mgr.set(data.a, 5);
+  assert(undo_entries(mgr) == 2);
+
+  // The merged entry goes from the value before its first change to the value after its last one
+  assert(mgr.undo() && data.a == 3);
+  assert(mgr.undo() && data.a == 0);
+  assert(mgr.redo() && data.a == 3);
+}
+
+void by_count()
+{
+  StaticDataManager mgr;
+  Data data;
+  mgr.set_coalescing_policy(CoalescingPolicy::every(3));
+
+  for (int i = 1; i <= 7; ++i)
+    mgr.set(data.a, i);
+  assert(undo_entries(mgr) == 3);
+  assert(mgr.undo() && data.a == 6);
+  assert(mgr.undo() && data.a == 3);
+  assert(mgr.undo() && data.a == 0);
+}
+
+void other_element_or_group()
+{
+  StaticDataManager mgr;
+  Data data;
+  mgr.set_coalescing_policy(CoalescingPolicy::every(10));
+
+  // Changing another element ends the run
+  mgr.set(data.a, 1);
+  mgr.set(data.a, 2);
+  mgr.set(data.b, 1);
+  mgr.set(data.a, 3);
+  assert(undo_entries(mgr) == 3);
+
+  // Grouped changes & transactions are never merged
+  mgr.set(data.a, 4, true);
+  assert(undo_entries(mgr) == 3);
+  mgr.set(data.a, 5);
+  {
+    auto transaction = mgr.transaction();
+    mgr.set(data.a, 6);
+  }
+  mgr.set(data.a, 7);
+  assert(undo_entries(mgr) == 6);
+}
+
+void continuous_edit()
+{
+  StaticDataManager mgr;
+  Data data;
+  int calls = 0;
+  mgr.register_callback(data.a, [&calls](const int &) { ++calls; });
+
+  // No merging by default
+  mgr.set(data.a, 1);
+  mgr.set(data.a, 2);
+  assert(undo_entries(mgr) == 2);
+
+  {
+    auto edit = mgr.continuous_edit();
+    for (int i = 3; i <= 10; ++i)
+      mgr.set(data.a, i);
+  }
+  assert(undo_entries(mgr) == 3);
+  assert(calls == 10); // Callbacks are still called on every change
+
+  // The edit has ended
+  mgr.set(data.a, 11);
+  assert(undo_entries(mgr) == 4);
+  assert(mgr.undo() && data.a == 10);
+  assert(mgr.undo() && data.a == 2);
+}
+
+int main()
+{
+  by_window();
+  by_count();
+  other_element_or_group();
+  continuous_edit();
+  printf("coalescing tests passed\n");
+  return 0;
+}
@@ -0,0 +1,65 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#include "static_data_manager.hpp"
+#include <cassert>
+#include <cstdio>
+
+using namespace dmgmt;
+
+void computed_after_remove_callback()
+{
+  StaticDataManager mgr;
+  int a = 0;
+  int b = 0;
+  int calls = 0;
+  mgr.register_callback(a, [&calls](const int &) { ++calls; });
+  auto sum = mgr.register_computed([](int x, int y) { return x + y; }, a, b);
+  assert(*sum == 0);
+
+  // Removing the user's callbacks leaves the computed value watching its input
+  mgr.remove_callback(a);
+  mgr.set(a, 5);
+  assert(calls == 0);
+  assert(sum.stale() && *sum == 5);
+
+  mgr.remove_computed(sum);
+  mgr.set(b, 1);
+  assert(mgr.computed_count() == 0);
+}
+
+void computed_cutoff()
+{
+  StaticDataManager mgr;
+  int a = 1;
+  int computations = 0;
+  auto sign = mgr.register_computed([](int x) { return x >= 0; }, a);
+  auto label = mgr.register_computed(
+      [&computations](bool positive) {
+        ++computations;
+        return positive ? 1 : -1;
+      },
+      sign);
+  assert(*label == 1 && computations == 1);
+  mgr.set(a, 2); // sign is computed again to the same value: label is not
+  assert(*label == 1 && computations == 1);
+  mgr.set(a, -2);
+  assert(*label == -1 && computations == 2);
+  mgr.undo();
+  assert(*label == 1 && computations == 3);
+}
+
+int main()
+{
+  computed_after_remove_callback();
+  computed_cutoff();
+  printf("computed tests passed\n");
+  return 0;
+}
@@ -0,0 +1,88 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#include "containment_index.hpp"
+#include "static_data_manager.hpp"
+#include <cassert>
+#include <cstdio>
+#include <vector>
+
+using namespace dmgmt;
+
+struct Wrapper
+{
+  int value = 0;
+};
+
+struct Data
+{
+  Wrapper wrapper;
+  int other = 0;
+};
+
+std::vector<Signature> enclosing(ContainmentIndex &index, const Signature &sig)
+{
+  std::vector<Signature> found;
+  index.enclosing(sig, [&found](const Signature &container) { found.push_back(container); });
+  return found;
+}
+
+void single_member_index()
+{
+  Data data;
+  for (bool memberFirst : {true, false})
+  {
+    ContainmentIndex index;
+    if (memberFirst)
+      index.insert(data.wrapper.value);
+    index.insert(data);
+    index.insert(data.wrapper);
+    if (!memberFirst)
+      index.insert(data.wrapper.value);
+
+    // A structure & its only member enclose each other, whatever the insertion order
+    auto found = enclosing(index, data.wrapper.value);
+    assert(found.size() == 2 && found[0] == data.wrapper && found[1] == data);
+    found = enclosing(index, data.wrapper);
+    assert(found.size() == 2 && found[0] == data.wrapper.value && found[1] == data);
+    found = enclosing(index, data.other);
+    assert(found.size() == 1 && found[0] == data);
+
+    index.erase(data.wrapper.value);
+    found = enclosing(index, data.wrapper);
+    assert(found.size() == 1 && found[0] == data);
+  }
+}
+
+void single_member_propagation()
+{
+  StaticDataManager mgr;
+  Data data;
+  int values = 0;
+  int wrappers = 0;
+  int roots = 0;
+  mgr.set_containment_dependencies(true);
+  mgr.register_callback(data, [&roots](const Data &) { ++roots; });
+  mgr.register_callback(data.wrapper, [&wrappers](const Wrapper &) { ++wrappers; });
+  mgr.register_callback(data.wrapper.value, [&values](const int &) { ++values; });
+
+  mgr.set(data.wrapper.value, 1);
+  assert(values == 1 && wrappers == 1 && roots == 1);
+  mgr.set(data.wrapper, Wrapper{2});
+  assert(values == 2 && wrappers == 2 && roots == 2);
+}
+
+int main()
+{
+  single_member_index();
+  single_member_propagation();
+  printf("containment tests passed\n");
+  return 0;
+}
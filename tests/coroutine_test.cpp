@@ -0,0 +1,91 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#include "static_data_manager.hpp"
+#include <cassert>
+#include <coroutine>
+#include <cstdio>
+#include <exception>
+#include <utility>
+
+using namespace dmgmt;
+
+/**
+ * @brief Coroutine whose frame is destroyed with the task, suspended or not
+ */
+struct Task
+{
+  struct promise_type
+  {
+    Task get_return_object() { return Task{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+
+  explicit Task(std::coroutine_handle<promise_type> handle) : mHandle{handle} {}
+  Task(Task &&other) noexcept : mHandle{std::exchange(other.mHandle, {})} {}
+  ~Task()
+  {
+    if (mHandle)
+      mHandle.destroy();
+  }
+
+  bool done() const { return mHandle.done(); }
+
+  std::coroutine_handle<promise_type> mHandle;
+};
+
+Task wait_changes(StaticDataManager &mgr, const int &element, int changes, int &seen)
+{
+  for (int i = 0; i < changes; ++i)
+  {
+    co_await changed(mgr, element);
+    ++seen;
+  }
+}
+
+void wake_after_remove_callback()
+{
+  StaticDataManager mgr;
+  int a = 0;
+  int seen = 0;
+  Task task = wait_changes(mgr, a, 1, seen);
+
+  // Removing the user's callbacks leaves the waiters of the element in place
+  mgr.remove_callback(a);
+  mgr.set(a, 1);
+  assert(seen == 1 && task.done());
+  assert(mgr.awaiting_count() == 0);
+  assert(!mgr.runtime_propagation_needed());
+}
+
+void drop_abandoned_waits()
+{
+  StaticDataManager mgr;
+  int a = 0;
+  int seen = 0;
+  {
+    Task task = wait_changes(mgr, a, 1, seen);
+    assert(mgr.awaiting_count() == 1 && mgr.runtime_propagation_needed());
+  }
+  assert(mgr.awaiting_count() == 0 && !mgr.runtime_propagation_needed());
+  mgr.set(a, 1);
+  assert(seen == 0);
+}
+
+int main()
+{
+  wake_after_remove_callback();
+  drop_abandoned_waits();
+  printf("coroutine tests passed\n");
+  return 0;
+}
@@ -0,0 +1,88 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#include "static_data_manager.hpp"
+#include <chrono>
+#include <cassert>
+#include <cstdio>
+
+using namespace dmgmt;
+using namespace std::chrono_literals;
+
+static_assert(Instrumentation::enabled, "build with -DDMGMT_ENABLE_INSTRUMENTATION");
+
+struct Data
+{
+  int a = 0;
+  int b = 0;
+};
+
+void histogram()
+{
+  LatencyHistogram latencies;
+  assert(latencies.quantile(0.5) == 0ns && latencies.quantile(1.0) == 0ns);
+  assert(latencies.mean() == 0ns);
+
+  latencies.add(1ns);
+  latencies.add(3ns);
+  latencies.add(100ns);
+  assert(latencies.count() == 3);
+  assert(latencies.bucket(0) == 1 && latencies.bucket(1) == 1 && latencies.bucket(6) == 1);
+  assert(latencies.quantile(0.0) == 1ns);
+  assert(latencies.quantile(0.5) == 3ns);
+  assert(latencies.quantile(1.0) == 127ns);
+}
+
+void manager_counters()
+{
+  StaticDataManager mgr;
+  Data data;
+  mgr.register_callback(data.a, [](const int &) {});
+  mgr.register_callback(data.b, [](const int &) {});
+  mgr.register_dependency(data.a, data.b);
+
+  mgr.set(data.a, 1);
+  const Instrumentation &stats = mgr.instrumentation();
+  assert(stats.changes(data.a) == 1 && stats.changes(data.b) == 0);
+  assert(stats.propagation().propagations == 1 && stats.propagation().callbacks == 2);
+  assert(stats.propagation().compilations == 1 && stats.propagation().max_depth == 2);
+  assert(stats.snapshot_bytes() > 0);
+  assert(stats.latency(InstrumentedOperation::Set).count() == 1);
+
+  // Writing the same value is neither timed nor propagated
+  mgr.set(data.a, 1);
+  assert(stats.elided_writes() == 1);
+  assert(stats.latency(InstrumentedOperation::Set).count() == 1);
+
+  // The plan of a is cached
+  mgr.set(data.a, 2);
+  assert(stats.changes(data.a) == 2);
+  assert(stats.propagation().propagations == 2 && stats.propagation().compilations == 1);
+
+  mgr.undo();
+  mgr.redo();
+  assert(stats.latency(InstrumentedOperation::Undo).count() == 1);
+  assert(stats.latency(InstrumentedOperation::Redo).count() == 1);
+  assert(stats.latency(InstrumentedOperation::Set).quantile(1.0) > 0ns);
+
+  mgr.reset_instrumentation();
+  assert(stats.changes().empty() && stats.elided_writes() == 0 && stats.snapshot_bytes() == 0);
+  assert(stats.propagation().propagations == 0);
+  assert(stats.latency(InstrumentedOperation::Set).count() == 0);
+  assert(stats.latency(InstrumentedOperation::Set).quantile(0.99) == 0ns);
+}
+
+int main()
+{
+  histogram();
+  manager_counters();
+  printf("instrumentation tests passed\n");
+  return 0;
+}
@@ -0,0 +1,151 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#include "data_manager.hpp"
+#include <memory>
+#include <string>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace dmgmt;
+
+struct Data
+{
+  int a = 0;
+  int b = 0;
+};
+
+struct Other
+{
+  long a = 0;
+};
+
+using Manager = DataManager<Mapped<Data>>;
+
+std::unique_ptr<Manager> open_manager(const std::string &path)
+{
+  return std::make_unique<Manager>(std::make_unique<MappedStorage<Data>>(path));
+}
+
+/**
+ * @brief Marks a closed file as not cleanly closed, as if its process had died
+ */
+void mark_unclean(const std::string &path)
+{
+  int file = ::open(path.c_str(), O_RDWR);
+  std::uint64_t clean = 0;
+  ssize_t written = ::pwrite(file, &clean, sizeof(clean), 2 * sizeof(std::uint64_t)); // After magic & layout
+  ::close(file);
+  assert(written == sizeof(clean));
+}
+
+/**
+ * @brief Overwrites the start of a checkpoint slot of a closed file
+ */
+void corrupt_slot(const std::string &path, std::size_t slot)
+{
+  std::size_t page = std::size_t(::sysconf(_SC_PAGESIZE)); // Data fits a page: header, live object & slots take one each
+  int file = ::open(path.c_str(), O_RDWR);
+  int garbage = -1;
+  ssize_t written = ::pwrite(file, &garbage, sizeof(garbage), off_t(page * (2 + slot)));
+  ::close(file);
+  assert(written == sizeof(garbage));
+}
+
+void created_then_restored(const std::string &path)
+{
+  {
+    auto mgr = open_manager(path);
+    assert(mgr->mapped_storage()->origin() == StorageOrigin::Created);
+    assert(mgr->get().a == 0 && mgr->get().b == 0);
+    mgr->set(mgr->get().a, 1);
+    mgr->set(mgr->get().b, 2);
+  }
+
+  // A cleanly closed file hands its live object over, checkpointed or not
+  auto mgr = open_manager(path);
+  assert(mgr->mapped_storage()->origin() == StorageOrigin::Restored);
+  assert(mgr->get().a == 1 && mgr->get().b == 2);
+  assert(!mgr->undo());
+}
+
+void recovered(const std::string &path)
+{
+  {
+    auto mgr = open_manager(path);
+    mgr->set(mgr->get().a, 10);
+    assert(mgr->checkpoint());
+    mgr->set(mgr->get().a, 20);
+    assert(mgr->checkpoint());
+    mgr->set(mgr->get().a, 30); // Lost: never checkpointed
+  }
+
+  // A process that died restarts from its last checkpoint
+  mark_unclean(path);
+  {
+    auto mgr = open_manager(path);
+    assert(mgr->mapped_storage()->origin() == StorageOrigin::Recovered);
+    assert(mgr->get().a == 20);
+    std::uint64_t checkpoints = mgr->mapped_storage()->checkpoints();
+    mgr->set(mgr->get().a, 40);
+    assert(mgr->checkpoint());
+    assert(mgr->mapped_storage()->checkpoints() == checkpoints + 1);
+    mgr->set(mgr->get().a, 50);
+    assert(mgr->checkpoint());
+  }
+
+  // The last checkpoint went to slot 1 and is corrupted: the one before it is used
+  mark_unclean(path);
+  corrupt_slot(path, 1);
+  auto mgr = open_manager(path);
+  assert(mgr->mapped_storage()->origin() == StorageOrigin::Recovered);
+  assert(mgr->get().a == 40);
+}
+
+void layout_mismatch(const std::string &path)
+{
+  {
+    auto mgr = open_manager(path);
+    mgr->set(mgr->get().a, 1);
+  }
+
+  // A file written for another type starts over
+  {
+    MappedStorage<Other> other{path};
+    assert(other.origin() == StorageOrigin::Created);
+    assert(other.data().a == 0);
+  }
+  auto mgr = open_manager(path);
+  assert(mgr->mapped_storage()->origin() == StorageOrigin::Created);
+  assert(mgr->get().a == 0);
+}
+
+void inline_data()
+{
+  DataManager<Data> mgr;
+  assert(mgr.mapped_storage() == nullptr);
+  assert(!mgr.checkpoint());
+}
+
+int main()
+{
+  std::string path = "/tmp/dmgmt_mapped_storage_test_" + std::to_string(::getpid());
+  created_then_restored(path);
+  recovered(path);
+  layout_mismatch(path);
+  ::unlink(path.c_str());
+  inline_data();
+  printf("mapped storage tests passed\n");
+  return 0;
+}
@@ -0,0 +1,117 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#include "static_data_manager.hpp"
+#include <cassert>
+#include <cstdio>
+
+using namespace dmgmt;
+
+struct Data
+{
+  int a = 0;
+  int b = 0;
+  int total = 0;
+};
+
+struct Counts
+{
+  int a = 0;
+  int b = 0;
+  int total = 0;
+};
+
+void count_callbacks(StaticDataManager &mgr, Data &data, Counts &counts)
+{
+  mgr.register_callback(data.a, [&counts](const int &) { ++counts.a; });
+  mgr.register_callback(data.b, [&counts](const int &) { ++counts.b; });
+  mgr.register_callback(data.total, [&counts](const int &) { ++counts.total; });
+  mgr.register_dependency(data.a, data.total);
+  mgr.register_dependency(data.b, data.total);
+}
+
+void one_propagation_per_flush()
+{
+  StaticDataManager mgr;
+  Data data;
+  Counts counts;
+  count_callbacks(mgr, data, counts);
+  mgr.set_propagation_mode(PropagationMode::Deferred);
+
+  mgr.set(data.a, 1);
+  mgr.set(data.b, 2);
+  mgr.set(data.a, 3);
+  assert(counts.a == 0 && counts.b == 0 && counts.total == 0);
+  assert(mgr.history_usage().undo_entries == 3); // The history is still recorded change by change
+
+  mgr.flush();
+  assert(counts.a == 1 && counts.b == 1 && counts.total == 1);
+  mgr.flush(); // Nothing changed since
+  assert(counts.a == 1 && counts.b == 1 && counts.total == 1);
+
+  assert(mgr.undo() && mgr.undo());
+  assert(data.a == 1 && data.b == 0);
+  assert(counts.a == 1);
+  mgr.flush();
+  assert(counts.a == 2 && counts.b == 2 && counts.total == 2);
+}
+
+void one_propagation_per_transaction()
+{
+  StaticDataManager mgr;
+  Data data;
+  Counts counts;
+  count_callbacks(mgr, data, counts);
+  mgr.set_propagation_mode(PropagationMode::Deferred);
+
+  // A committed transaction waits for the flush too
+  {
+    auto transaction = mgr.transaction();
+    mgr.set(data.a, 1);
+    mgr.set(data.b, 2);
+  }
+  assert(counts.total == 0 && mgr.history_usage().undo_entries == 1);
+  mgr.flush();
+  assert(counts.a == 1 && counts.b == 1 && counts.total == 1);
+
+  // Back in immediate mode, a transaction propagates once at commit
+  mgr.set_propagation_mode(PropagationMode::Immediate);
+  {
+    auto transaction = mgr.transaction();
+    mgr.set(data.a, 3);
+    mgr.set(data.b, 4);
+  }
+  assert(counts.a == 2 && counts.b == 2 && counts.total == 2);
+}
+
+void switching_to_immediate_flushes()
+{
+  StaticDataManager mgr;
+  Data data;
+  Counts counts;
+  count_callbacks(mgr, data, counts);
+  mgr.set_propagation_mode(PropagationMode::Deferred);
+
+  mgr.set(data.a, 1);
+  mgr.set(data.a, 2);
+  mgr.set_propagation_mode(PropagationMode::Immediate);
+  assert(counts.a == 1 && counts.total == 1);
+  mgr.set(data.b, 1);
+  assert(counts.b == 1 && counts.total == 2);
+}
+
+int main()
+{
+  one_propagation_per_flush();
+  one_propagation_per_transaction();
+  switching_to_immediate_flushes();
+  printf("propagation mode tests passed\n");
+  return 0;
+}
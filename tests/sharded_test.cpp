@@ -0,0 +1,93 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#include "sharded_manager.hpp"
+#include <stdexcept>
+#include <thread>
+#include <cassert>
+#include <cstdio>
+
+using namespace dmgmt;
+
+struct Data
+{
+  int source = 0;
+  int destination = 0;
+};
+
+std::thread::id thread_of(ShardedManager &mgr, std::size_t shard)
+{
+  std::thread::id id;
+  mgr.post(shard, [&id](StaticDataManager &) { id = std::this_thread::get_id(); });
+  mgr.wait();
+  return id;
+}
+
+void cross_shard_dependency()
+{
+  ShardedManager mgr{2};
+  Data data;
+  mgr.place(data.source, 0);
+  mgr.place(data.destination, 1);
+  std::thread::id sourceThread = thread_of(mgr, 0);
+  std::thread::id destinationThread = thread_of(mgr, 1);
+  assert(sourceThread != destinationThread);
+
+  int calls = 0;
+  std::thread::id calledOn;
+  mgr.register_callback(data.destination, [&](const int &) {
+    ++calls;
+    calledOn = std::this_thread::get_id();
+  });
+  mgr.register_dependency(data.source, data.destination);
+
+  // wait() covers the message sent to the destination shard
+  mgr.set(data.source, 1);
+  mgr.wait();
+  assert(data.source == 1 && calls == 1 && calledOn == destinationThread);
+
+  mgr.set(data.source, 2);
+  mgr.set(data.source, 3);
+  mgr.wait();
+  assert(calls >= 2 && calledOn == destinationThread);
+  ShardStats stats = mgr.stats();
+  assert(stats.batches >= 2 && stats.forwarded == stats.batches && stats.failed == 0);
+}
+
+void throwing_tasks()
+{
+  ShardedManager mgr{2};
+  Data data;
+  mgr.place(data.destination, 1);
+  int calls = 0;
+  mgr.register_callback(data.destination, [&calls](const int &value) {
+    ++calls;
+    if (value == 1)
+      throw std::runtime_error("callback failure");
+  });
+  mgr.post(0, [](StaticDataManager &) { throw std::runtime_error("task failure"); });
+  mgr.set(data.destination, 1);
+  mgr.wait();
+  assert(mgr.stats().failed == 2);
+
+  // The shard threads go on with the next tasks
+  mgr.set(data.destination, 2);
+  mgr.set(data.source, 3);
+  mgr.wait();
+  assert(calls == 2 && data.destination == 2 && data.source == 3);
+}
+
+int main()
+{
+  cross_shard_dependency();
+  throwing_tasks();
+  printf("sharded tests passed\n");
+  return 0;
+}
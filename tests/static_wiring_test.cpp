@@ -0,0 +1,74 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#include "data_manager.hpp"
+#include <cassert>
+#include <cstdio>
+
+struct Point
+{
+  int x = 0;
+  int y = 0;
+};
+
+struct Shape
+{
+  Point origin;
+  int width = 0;
+};
+
+int gOrigins = 0;
+void on_origin(const Point &) { ++gOrigins; }
+
+using namespace dmgmt;
+
+using X = Path<&Shape::origin, &Point::x>;
+using Origin = Path<&Shape::origin>;
+using Width = Path<&Shape::width>;
+
+using ShapeManager = DataManager<Shape, Callback<Origin, &on_origin>, Depends<X, Origin>>;
+
+void wired_with_runtime_callbacks()
+{
+  gOrigins = 0;
+  ShapeManager mgr;
+  int xs = 0;
+  int origins = 0;
+  mgr.register_callback(mgr.get().origin.x, [&xs](const int &) { ++xs; });
+  mgr.register_callback(mgr.get().origin, [&origins](const Point &) { ++origins; });
+
+  mgr.set<X>(1);
+  assert(xs == 1 && origins == 1 && gOrigins == 1);
+
+  // Once the run-time registrations are removed, the wired propagation is the same
+  mgr.remove_callback(mgr.get().origin.x);
+  mgr.set<X>(2);
+  assert(xs == 1 && origins == 2 && gOrigins == 2);
+}
+
+void unwired_path()
+{
+  static_assert(!StaticWiring<Shape, Callback<Origin, &on_origin>>::is_wired<Width>);
+  ShapeManager mgr;
+  int widths = 0;
+  mgr.register_callback(mgr.get().width, [&widths](const int &) { ++widths; });
+  mgr.set<Width>(10);
+  assert(mgr.get().width == 10 && widths == 1);
+  mgr.undo();
+  assert(mgr.get().width == 0 && widths == 2);
+}
+
+int main()
+{
+  wired_with_runtime_callbacks();
+  unwired_path();
+  printf("static wiring tests passed\n");
+  return 0;
+}
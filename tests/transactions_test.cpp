@@ -0,0 +1,117 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#include "static_data_manager.hpp"
+#include <cassert>
+#include <cstdio>
+
+using namespace dmgmt;
+
+struct Data
+{
+  int a = 0;
+  int b = 0;
+  int total = 0;
+};
+
+struct Counts
+{
+  int a = 0;
+  int b = 0;
+  int total = 0;
+};
+
+void count_callbacks(StaticDataManager &mgr, Data &data, Counts &counts)
+{
+  mgr.register_callback(data.a, [&counts](const int &) { ++counts.a; });
+  mgr.register_callback(data.b, [&counts](const int &) { ++counts.b; });
+  mgr.register_callback(data.total, [&counts](const int &) { ++counts.total; });
+  mgr.register_dependency(data.a, data.total);
+  mgr.register_dependency(data.b, data.total);
+}
+
+void one_undo_entry()
+{
+  StaticDataManager mgr;
+  Data data;
+  mgr.set(data.a, 1);
+
+  mgr.begin_transaction();
+  mgr.set(data.a, 2);
+  mgr.set(data.b, 3);
+  mgr.set(data.a, 4);
+  mgr.commit_transaction();
+  assert(mgr.history_usage().undo_entries == 2);
+
+  // The whole transaction is undone & redone at once
+  assert(mgr.undo());
+  assert(data.a == 1 && data.b == 0);
+  assert(mgr.redo());
+  assert(data.a == 4 && data.b == 3);
+  assert(mgr.undo() && mgr.undo());
+  assert(data.a == 0 && !mgr.undo());
+}
+
+void one_propagation()
+{
+  StaticDataManager mgr;
+  Data data;
+  Counts counts;
+  count_callbacks(mgr, data, counts);
+
+  {
+    auto transaction = mgr.transaction();
+    mgr.set(data.a, 1);
+    mgr.set(data.b, 2);
+    mgr.set(data.a, 3);
+    assert(counts.a == 0 && counts.b == 0 && counts.total == 0);
+  }
+
+  // Each callback is called once, the shared dependant too
+  assert(counts.a == 1 && counts.b == 1 && counts.total == 1);
+  assert(mgr.undo());
+  assert(counts.a == 2 && counts.b == 2 && counts.total == 2);
+}
+
+void nested_transactions()
+{
+  StaticDataManager mgr;
+  Data data;
+  Counts counts;
+  count_callbacks(mgr, data, counts);
+
+  mgr.begin_transaction();
+  mgr.set(data.a, 1);
+  mgr.begin_transaction();
+  mgr.set(data.b, 2);
+  mgr.commit_transaction();
+  assert(counts.a == 0 && counts.b == 0); // Only the outermost commit propagates
+  mgr.commit_transaction();
+  assert(counts.a == 1 && counts.b == 1 && counts.total == 1);
+  assert(mgr.history_usage().undo_entries == 1);
+
+  // The next transaction is a new entry
+  {
+    auto transaction = mgr.transaction();
+    mgr.set(data.a, 5);
+  }
+  assert(mgr.history_usage().undo_entries == 2);
+  assert(mgr.undo());
+  assert(data.a == 1 && data.b == 2);
+}
+
+int main()
+{
+  one_undo_entry();
+  one_propagation();
+  nested_transactions();
+  printf("transactions tests passed\n");
+  return 0;
+}
@@ -0,0 +1,117 @@
+/**
+ * Copyright (C) 2020 Etienne Santoul - All Rights Reserved
+ * You may use, distribute and modify this code under the
+ * terms of the BSD 2-Clause License
+ *
+ * You should have received a copy of the BSD 2-Clause License
+ * with this file. If not, please visit: 
+ * https://github.com/esantoul/data-management
+ */
+
+#include "static_data_manager.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+#include <unistd.h>
+
+using namespace dmgmt;
+
+struct Data
+{
+  int value = 0;
+  std::string name;
+};
+
+std::string journal_path()
+{
+  return "/tmp/dmgmt_undo_journal_test_" + std::to_string(::getpid());
+}
+
+std::unique_ptr<UndoJournal> string_journal()
+{
+  auto journal = std::make_unique<UndoJournal>(journal_path(), 4096);
+  journal->register_serializer<std::string>(
+      [](const std::string &value, std::vector<std::byte> &out) {
+        std::size_t size = out.size();
+        out.resize(size + value.size());
+        std::memcpy(out.data() + size, value.data(), value.size());
+      },
+      [](const std::byte *data, std::size_t size, std::string &element) {
+        element.assign(reinterpret_cast<const char *>(data), size);
+      });
+  return journal;
+}
+
+void undo_through_journal()
+{
+  StaticDataManager mgr;
+  Data data;
+  int calls = 0;
+  mgr.register_callback(data.value, [&calls](const int &) { ++calls; });
+  mgr.set_history_limits(2, std::size_t(-1));
+  mgr.set_undo_journal(string_journal());
+
+  for (int i = 1; i <= 6; ++i)
+  {
+    mgr.set(data.value, i);
+    mgr.set(data.name, std::string(std::size_t(i), 'x'));
+  }
+
+  // Only the two most recent changes stay in memory
+  HistoryUsage usage = mgr.history_usage();
+  assert(usage.undo_entries == 2);
+  assert(usage.journal_entries == 10);
+  calls = 0;
+
+  for (int i = 6; i >= 1; --i)
+  {
+    assert(data.value == i && data.name == std::string(std::size_t(i), 'x'));
+    assert(mgr.undo()); // name
+    assert(mgr.undo()); // value
+  }
+  assert(data.value == 0 && data.name.empty());
+  assert(!mgr.undo());
+  assert(calls == 6); // Changes undone from the journal call the callbacks too
+
+  // They are redone from the journal as well
+  for (int i = 1; i <= 6; ++i)
+  {
+    assert(mgr.redo());
+    assert(mgr.redo());
+    assert(data.value == i && data.name == std::string(std::size_t(i), 'x'));
+  }
+  assert(!mgr.redo());
+  assert(calls == 12);
+}
+
+void new_change_drops_journaled_redos()
+{
+  StaticDataManager mgr;
+  Data data;
+  mgr.set_history_limits(1, std::size_t(-1));
+  mgr.set_undo_journal(string_journal());
+
+  for (int i = 1; i <= 4; ++i)
+    mgr.set(data.value, i);
+  assert(mgr.undo() && mgr.undo() && mgr.undo());
+  assert(data.value == 1);
+
+  mgr.set(data.value, 10);
+  assert(!mgr.redo());
+  assert(mgr.undo() && data.value == 1);
+  assert(mgr.undo() && data.value == 0);
+  assert(!mgr.undo());
+}
+
+int main()
+{
+  undo_through_journal();
+  new_change_drops_journaled_redos();
+  assert(::access(journal_path().c_str(), F_OK) != 0); // The journal removes its file
+  printf("undo journal tests passed\n");
+  return 0;
+}